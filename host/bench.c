@@ -0,0 +1,177 @@
+// Render benchmark: runs every update proc of both clock faces, and the
+// settings inbox, against the counting mock in pebble.c. Absolute times are
+// the host's, compare them between builds rather than with the watch.
+
+#define main pebble_main
+#include "../src/main.c"
+#undef main
+
+#define BENCH_FRAMES 20000
+#define BENCH_COLD_FRAMES 500
+#define BENCH_MESSAGES 5000
+
+typedef struct {
+  LayerUpdateProc update_proc;
+  const char *name;
+} ProcName;
+
+static const ProcName PROC_NAMES[] = {
+  { canvas_update_proc, "canvas" },
+  { battery_update_proc, "battery" },
+  { hands_update_proc, "hands" },
+  { second_update_proc, "second" },
+#if defined(PBL_HEALTH)
+  { steps_update_proc, "steps" },
+#endif
+#if defined(DIGIT_ATLAS)
+  { digits_update_proc, "digits" },
+#endif
+};
+
+
+
+// Monotonic nanoseconds
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+
+// Print one result line, every count divided by the number of runs
+static void report(char clock, const char *name, uint32_t runs, uint64_t elapsed_ns) {
+  printf("%-8s %c  %-16s %9.1f %11.1f %10.0f %9.2f\n", HOST_PLATFORM, clock, name,
+         (double)mock_stats.ops / runs, (double)mock_stats.state_changes / runs,
+         (double)elapsed_ns / runs, (double)mock_stats.allocations / runs);
+}
+
+
+
+// Run one update proc over and over, cold redraws the background each time
+static void bench_proc(char clock, const char *name, Layer *layer, LayerUpdateProc update_proc,
+                       bool cold) {
+  GContext *ctx = mock_context();
+  uint32_t frames = cold ? BENCH_COLD_FRAMES : BENCH_FRAMES;
+  uint64_t elapsed_ns = 0;
+  mock_reset_stats();
+  for (uint32_t i = 0; i < frames; ++i) {
+    if (cold) {
+      // Not part of the frame, but counted like it (one free per frame)
+      invalidate_background();
+    }
+    uint64_t start = now_ns();
+    update_proc(layer, ctx);
+    elapsed_ns += now_ns() - start;
+  }
+  report(clock, name, frames, elapsed_ns);
+}
+
+
+
+// Name of a face layer's update proc
+static const char *proc_name(LayerUpdateProc update_proc) {
+  for (size_t i = 0; i < ARRAY_LENGTH(PROC_NAMES); ++i) {
+    if (PROC_NAMES[i].update_proc == update_proc) {
+      return PROC_NAMES[i].name;
+    }
+  }
+  return "?";
+}
+
+
+
+// Every update proc of the current face, the way a full redraw runs them
+static void bench_face(char clock) {
+  bench_proc(clock, "canvas (cold)", s_canvas_layer, canvas_update_proc, true);
+  bench_proc(clock, "canvas (cached)", s_canvas_layer, canvas_update_proc, false);
+  if (s_battery_layer) {
+    bench_proc(clock, "battery", s_battery_layer, battery_update_proc, false);
+  }
+#if defined(PBL_HEALTH)
+  if (s_steps_layer) {
+    bench_proc(clock, "steps", s_steps_layer, steps_update_proc, false);
+  }
+#endif
+  for (int i = 0; i < s_face->num_layers; ++i) {
+    const FaceLayer *spec = &s_face->layers[i];
+    if (spec->type == FaceLayerCanvas) {
+      bench_proc(clock, proc_name(spec->update_proc), *spec->layer, spec->update_proc, false);
+    }
+  }
+}
+
+
+
+// A settings message for the given face, as the phone would send it
+static uint32_t write_settings_message(uint8_t *buffer, uint16_t size, char clock,
+                                       bool strap_details) {
+  ClaySettings current = settings;
+  default_settings();
+  settings.SelectClock = clock;
+  settings.StrapDetails = strap_details;
+  settings.StepsComplication = true;
+  uint8_t blob[SETTINGS_MESSAGE_SIZE];
+  encode_settings_message(blob);
+  settings = current;
+
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_data(&iter, MESSAGE_KEY_SettingsBlob, blob, sizeof(blob));
+  return dict_write_end(&iter);
+}
+
+
+
+// Deliver a settings message through the AppMessage handler
+static void receive(const uint8_t *buffer, uint32_t size) {
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, buffer, size);
+  inbox_received_handler(&iter, NULL);
+}
+
+
+
+// Messages that differ in the strap details, which invalidates the cached background
+static void bench_inbox(char clock) {
+  uint8_t messages[2][dict_calc_buffer_size(1, SETTINGS_MESSAGE_SIZE)];
+  uint32_t sizes[2] = {
+    write_settings_message(messages[0], sizeof(messages[0]), clock, false),
+    write_settings_message(messages[1], sizeof(messages[1]), clock, true),
+  };
+
+  uint64_t elapsed_ns = 0;
+  mock_reset_stats();
+  for (uint32_t i = 0; i < BENCH_MESSAGES; ++i) {
+    uint64_t start = now_ns();
+    receive(messages[i % 2], sizes[i % 2]);
+    elapsed_ns += now_ns() - start;
+  }
+  report(clock, "inbox", BENCH_MESSAGES, elapsed_ns);
+  printf("%-8s %c  %-16s %9.2f flash writes, %.2f dirty marks per message\n", HOST_PLATFORM, clock,
+         "", (double)mock_stats.flash_writes / BENCH_MESSAGES,
+         (double)mock_stats.dirty_marks / BENCH_MESSAGES);
+}
+
+
+
+int main(void) {
+  mock_clear_persist();
+  init();
+  // The launch frame, then the rest of startup
+  canvas_update_proc(s_canvas_layer, mock_context());
+  mock_run_timers(0);
+
+  printf("%-8s %-2s %-16s %9s %11s %10s %9s\n", "platform", "", "proc", "ops/frame", "state/frame",
+         "ns/frame", "allocs");
+  static const char CLOCKS[] = { 'd', 'a' };
+  for (size_t i = 0; i < ARRAY_LENGTH(CLOCKS); ++i) {
+    uint8_t message[dict_calc_buffer_size(1, SETTINGS_MESSAGE_SIZE)];
+    receive(message, write_settings_message(message, sizeof(message), CLOCKS[i], true));
+    bench_face(CLOCKS[i]);
+    bench_inbox(CLOCKS[i]);
+  }
+
+  deinit();
+  return 0;
+}
@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+#
+# Generates the headers the Pebble SDK would for one platform, so src/*.c
+# builds on the host: geometry.h from the wscript, message_keys.h and
+# resource_ids.h from package.json, plus the digit atlas the wscript adds
+# to DIGIT_ATLAS=1 builds.
+#
+# Usage: generate.py <platform> <output directory> [-DDIGIT_ATLAS]
+#
+
+import json
+import os.path
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+# The SDK defines these per platform, the wscript reads them
+PLATFORM_DEFINES = {
+    'aplite': [],
+    'basalt': [],
+    'chalk': ['PBL_ROUND'],
+    'diorite': [],
+    'emery': ['PBL_DISPLAY_WIDTH=200', 'PBL_DISPLAY_HEIGHT=228'],
+}
+
+
+class Env(object):
+    def __init__(self, platform):
+        self.PLATFORM_NAME = platform
+        self.DEFINES = PLATFORM_DEFINES[platform]
+
+
+class Output(object):
+    def __init__(self, path):
+        self.path = path
+
+    def write(self, text):
+        with open(self.path, 'w') as f:
+            f.write(text)
+
+
+class Task(object):
+    def __init__(self, env, output):
+        self.env = env
+        self.outputs = [Output(output)]
+
+
+def write_lines(path, lines):
+    with open(path, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+def main(platform, out_dir, digit_atlas):
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+
+    # The wscript only imports the Pebble SDK inside its build functions
+    wscript = {}
+    with open(os.path.join(ROOT, 'wscript')) as f:
+        exec(f.read(), wscript)
+    env = Env(platform)
+    env.DISPLAY = wscript['platform_display'](env)
+    wscript['generate_geometry'](Task(env, os.path.join(out_dir, 'geometry.h')))
+
+    with open(os.path.join(ROOT, 'package.json')) as f:
+        pebble = json.load(f)['pebble']
+
+    lines = ['// Generated by host/generate.py, do not edit', '#pragma once', '']
+    lines += ['#define MESSAGE_KEY_{} {}'.format(key, 10000 + i) for i, key in enumerate(pebble['messageKeys'])]
+    write_lines(os.path.join(out_dir, 'message_keys.h'), lines)
+
+    resources = pebble['resources']['media']
+    if digit_atlas:
+        resources = resources + [wscript['digit_atlas_resource'](platform)]
+    names = []
+    for media in resources:
+        targets = media.get('targetPlatforms')
+        if (targets is None or platform in targets) and media['name'] not in names:
+            names.append(media['name'])
+    lines = ['// Generated by host/generate.py, do not edit', '#pragma once', '']
+    lines += ['#define RESOURCE_ID_{} {}'.format(name, i + 1) for i, name in enumerate(names)]
+    write_lines(os.path.join(out_dir, 'resource_ids.h'), lines)
+
+
+if __name__ == '__main__':
+    main(sys.argv[1], sys.argv[2], '-DDIGIT_ATLAS' in sys.argv[3:])
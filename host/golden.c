@@ -0,0 +1,282 @@
+// Golden frames and redraw waste: draws both clock faces through the layer
+// tree with the rasterizer in pebble.c, compares a fixed scene with the images
+// in host/golden, and counts how many of the pixels each update proc repaints
+// really change from one tick to the next. Text is not rasterized.
+//
+//   golden <golden directory> <output directory>
+//
+// RECORD=1 rewrites the golden images instead of comparing them.
+
+#define main pebble_main
+#include "../src/main.c"
+#undef main
+
+// Ticks replayed for the redraw report
+#define REDRAW_FRAMES 60
+#define FRAME_PIXELS (PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT)
+
+typedef struct {
+  Layer **layer;
+  const char *name;
+} ProcLayer;
+
+static const ProcLayer PROC_LAYERS[] = {
+  { &s_canvas_layer, "canvas" },
+  { &s_battery_layer, "battery" },
+  { &s_hands_layer, "hands" },
+  { &s_second_layer, "second" },
+#if defined(PBL_HEALTH)
+  { &s_steps_layer, "steps" },
+#endif
+#if defined(DIGIT_ATLAS)
+  { &s_digits_layer, "digits" },
+#endif
+};
+
+// The golden scene: 10:08:30, full battery, second hand stepping
+static const struct tm GOLDEN_TIME = { .tm_hour = 10, .tm_min = 8, .tm_sec = 30, .tm_mday = 1,
+                                       .tm_year = 116 };
+
+
+
+// Draw a frame and copy it out as one GColor8 per pixel
+static void render(uint8_t *pixels) {
+  GContext *ctx = mock_render_window(s_window);
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  uint8_t *data = gbitmap_get_data(frame_buffer);
+  uint16_t stride = gbitmap_get_bytes_per_row(frame_buffer);
+  for (int y = 0; y < PBL_DISPLAY_HEIGHT; ++y) {
+    for (int x = 0; x < PBL_DISPLAY_WIDTH; ++x) {
+#if defined(PBL_BW)
+      bool white = (data[y * stride + x / 8] >> x % 8) & 1;
+      pixels[y * PBL_DISPLAY_WIDTH + x] = white ? GColorWhite.argb : GColorBlack.argb;
+#else
+      pixels[y * PBL_DISPLAY_WIDTH + x] = data[y * stride + x];
+#endif
+    }
+  }
+  graphics_release_frame_buffer(ctx, frame_buffer);
+}
+
+
+
+// Save a frame as a PBM (black and white) or PPM image
+static bool write_image(const char *path, const uint8_t *pixels) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+#if defined(PBL_BW)
+  fprintf(file, "P4\n%d %d\n", PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  for (int y = 0; y < PBL_DISPLAY_HEIGHT; ++y) {
+    uint8_t row[(PBL_DISPLAY_WIDTH + 7) / 8] = { 0 };
+    for (int x = 0; x < PBL_DISPLAY_WIDTH; ++x) {
+      // PBM rows are most significant bit first, 1 is black
+      if (pixels[y * PBL_DISPLAY_WIDTH + x] != GColorWhite.argb) {
+        row[x / 8] |= 0x80 >> x % 8;
+      }
+    }
+    fwrite(row, sizeof(row), 1, file);
+  }
+#else
+  fprintf(file, "P6\n%d %d\n255\n", PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  for (int i = 0; i < FRAME_PIXELS; ++i) {
+    GColor color = { .argb = pixels[i] };
+    uint8_t rgb[] = { color.r * 85, color.g * 85, color.b * 85 };
+    fwrite(rgb, sizeof(rgb), 1, file);
+  }
+#endif
+  return fclose(file) == 0;
+}
+
+
+
+// Load an image saved by write_image, false if it is missing or another size
+static bool read_image(const char *path, uint8_t *pixels) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  int width = 0, height = 0;
+  bool valid;
+#if defined(PBL_BW)
+  // One whitespace character ends the header
+  valid = fscanf(file, "P4 %d %d", &width, &height) == 2 && fgetc(file) != EOF;
+  uint8_t row[(PBL_DISPLAY_WIDTH + 7) / 8];
+  valid = valid && width == PBL_DISPLAY_WIDTH && height == PBL_DISPLAY_HEIGHT;
+  for (int y = 0; valid && y < PBL_DISPLAY_HEIGHT; ++y) {
+    valid = fread(row, sizeof(row), 1, file) == 1;
+    for (int x = 0; valid && x < PBL_DISPLAY_WIDTH; ++x) {
+      bool black = row[x / 8] & (0x80 >> x % 8);
+      pixels[y * PBL_DISPLAY_WIDTH + x] = black ? GColorBlack.argb : GColorWhite.argb;
+    }
+  }
+#else
+  int max = 0;
+  valid = fscanf(file, "P6 %d %d %d", &width, &height, &max) == 3 && fgetc(file) != EOF;
+  valid = valid && width == PBL_DISPLAY_WIDTH && height == PBL_DISPLAY_HEIGHT && max == 255;
+  for (int i = 0; valid && i < FRAME_PIXELS; ++i) {
+    uint8_t rgb[3];
+    valid = fread(rgb, sizeof(rgb), 1, file) == 1;
+    pixels[i] = GColorBlack.argb | (rgb[0] / 85) << 4 | (rgb[1] / 85) << 2 | rgb[2] / 85;
+  }
+#endif
+  fclose(file);
+  return valid;
+}
+
+
+
+// Show a clock face at the given time, drawn from the vectors on the next frame
+static void show_scene(char clock, const struct tm *t) {
+  ClaySettings previous = settings;
+  settings.SelectClock = clock;
+  apply_settings(&previous);
+  battery_callback((BatteryChargeState) { .charge_percent = 100 });
+  struct tm time = *t;
+  tick_handler(&time, FACE_TIME_UNITS | HOUR_UNIT);
+  invalidate_background();
+}
+
+
+
+// Compare the golden scene of a face with its recorded image, false on any difference
+static bool check_golden(char clock, const char *name, const char *golden_dir,
+                         const char *out_dir) {
+  static uint8_t s_vectors[FRAME_PIXELS], s_cached[FRAME_PIXELS], s_expected[FRAME_PIXELS];
+  show_scene(clock, &GOLDEN_TIME);
+  // The first frame draws the vectors and caches them, the second blits the cache
+  render(s_vectors);
+  render(s_cached);
+  bool passed = true;
+  if (memcmp(s_vectors, s_cached, sizeof(s_vectors)) != 0) {
+    printf("%-8s %-8s cached background differs from the vectors\n", HOST_PLATFORM, name);
+    passed = false;
+  }
+
+#if defined(PBL_BW)
+  const char *extension = "pbm";
+#else
+  const char *extension = "ppm";
+#endif
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s.%s", out_dir, name, extension);
+  write_image(path, s_cached);
+  char golden[256];
+  snprintf(golden, sizeof(golden), "%s/%s-%s.%s", golden_dir, HOST_PLATFORM, name, extension);
+  if (getenv("RECORD")) {
+    bool written = write_image(golden, s_cached);
+    printf("%-8s %-8s %s %s\n", HOST_PLATFORM, name, written ? "recorded" : "could not write", golden);
+    return passed && written;
+  }
+  if (!read_image(golden, s_expected)) {
+    printf("%-8s %-8s no golden image %s, record it with RECORD=1\n", HOST_PLATFORM, name, golden);
+    return false;
+  }
+
+  // Where the frame differs, to find it in the saved image
+  int mismatched = 0;
+  GRect box = GRect(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT, 0, 0);
+  for (int y = 0; y < PBL_DISPLAY_HEIGHT; ++y) {
+    for (int x = 0; x < PBL_DISPLAY_WIDTH; ++x) {
+      int i = y * PBL_DISPLAY_WIDTH + x;
+      if (s_cached[i] != s_expected[i]) {
+        mismatched++;
+        box.origin.x = x < box.origin.x ? x : box.origin.x;
+        box.origin.y = y < box.origin.y ? y : box.origin.y;
+        box.size.w = x > box.size.w ? x : box.size.w;
+        box.size.h = y > box.size.h ? y : box.size.h;
+      }
+    }
+  }
+  if (mismatched) {
+    printf("%-8s %-8s MISMATCH %d pixels in (%d,%d)-(%d,%d), see %s\n", HOST_PLATFORM, name,
+           mismatched, box.origin.x, box.origin.y, box.size.w, box.size.h, path);
+    return false;
+  }
+  printf("%-8s %-8s golden ok\n", HOST_PLATFORM, name);
+  return passed;
+}
+
+
+
+// Replay ticks on the current face, and count the pixels each proc repaints
+// against the ones that changed inside its layer
+static void report_redraw(const char *name) {
+  static uint8_t s_previous[FRAME_PIXELS], s_current[FRAME_PIXELS];
+  uint32_t painted[ARRAY_LENGTH(PROC_LAYERS)] = { 0 };
+  uint32_t changed[ARRAY_LENGTH(PROC_LAYERS)] = { 0 };
+  struct tm t = GOLDEN_TIME;
+  render(s_previous);
+  for (int frame = 0; frame < REDRAW_FRAMES; ++frame) {
+    // One tick of the unit the face subscribed to
+    TimeUnits units = s_tick_unit;
+    if (units == SECOND_UNIT && ++t.tm_sec == 60) {
+      t.tm_sec = 0;
+      units |= MINUTE_UNIT;
+    }
+    if ((units & MINUTE_UNIT) && ++t.tm_min == 60) {
+      t.tm_min = 0;
+      t.tm_hour = (t.tm_hour + 1) % 24;
+      units |= HOUR_UNIT;
+    }
+    tick_handler(&t, units);
+    render(s_current);
+
+    for (size_t i = 0; i < ARRAY_LENGTH(PROC_LAYERS); ++i) {
+      Layer *layer = *PROC_LAYERS[i].layer;
+      if (!layer || layer_get_hidden(layer)) {
+        continue;
+      }
+      GRect frame = layer_get_frame(layer);
+      painted[i] += frame.size.w * frame.size.h;
+      for (int y = frame.origin.y; y < frame.origin.y + frame.size.h; ++y) {
+        for (int x = frame.origin.x; x < frame.origin.x + frame.size.w; ++x) {
+          int index = y * PBL_DISPLAY_WIDTH + x;
+          changed[i] += s_previous[index] != s_current[index];
+        }
+      }
+    }
+    memcpy(s_previous, s_current, sizeof(s_current));
+  }
+
+  for (size_t i = 0; i < ARRAY_LENGTH(PROC_LAYERS); ++i) {
+    if (painted[i]) {
+      printf("%-8s %-8s %-8s %13.1f %13.1f %6.1f%%\n", HOST_PLATFORM, name, PROC_LAYERS[i].name,
+             (double)painted[i] / REDRAW_FRAMES, (double)changed[i] / REDRAW_FRAMES,
+             100.0 - 100.0 * changed[i] / painted[i]);
+    }
+  }
+}
+
+
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <golden directory> <output directory>\n", argv[0]);
+    return 2;
+  }
+  mock_clear_persist();
+  init();
+  // The launch frame, then the rest of startup
+  render((uint8_t[FRAME_PIXELS]){ 0 });
+  mock_run_timers(0);
+
+  static const struct {
+    char clock;
+    const char *name;
+  } FACES[] = { { 'a', "analog" }, { 'd', "digital" } };
+  bool passed = true;
+  for (size_t i = 0; i < ARRAY_LENGTH(FACES); ++i) {
+    passed = check_golden(FACES[i].clock, FACES[i].name, argv[1], argv[2]) && passed;
+  }
+  printf("%-8s %-8s %-8s %13s %13s %7s\n", "platform", "face", "proc", "painted/frame",
+         "changed/frame", "wasted");
+  for (size_t i = 0; i < ARRAY_LENGTH(FACES); ++i) {
+    show_scene(FACES[i].clock, &GOLDEN_TIME);
+    report_redraw(FACES[i].name);
+  }
+
+  deinit();
+  return passed ? 0 : 1;
+}
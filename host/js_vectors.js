@@ -0,0 +1,35 @@
+// Prints the settings messages and hashes src/js/settings.js produces for one
+// platform as a C header, for test.c to compare with the watch side.
+//
+// Usage: node js_vectors.js <platform>
+
+var config = require('../src/js/config');
+var settings = require('../src/js/settings');
+
+// Also in test.c (custom_settings), keep the two in sync
+var CUSTOM = {
+  SelectClock: 'a',
+  LeftStripeColor: 0xFF0055,
+  HandsColor: '#00AAFF',
+  SecondHandColor: '0xFFAA00',
+  BatteryBarToggle: false,
+  SecondsTimeout: { value: 45 },
+  NightMode: true,
+  QuietStart: 22,
+  SweepSeconds: true,
+  SweepFps: 15,
+  StepsComplication: true
+};
+
+function vector(name, values, platform) {
+  var bytes = settings.encode(values, config, platform);
+  return [
+    'static const uint8_t JS_' + name + '_MESSAGE[] = { ' + bytes.join(', ') + ' };',
+    'static const uint32_t JS_' + name + '_HASH = ' + settings.hash(bytes) + 'u;'
+  ];
+}
+
+var platform = process.argv[2];
+var lines = ['// Generated by host/js_vectors.js for ' + platform + ', do not edit', '#pragma once', ''];
+lines = lines.concat(vector('DEFAULT', {}, platform), vector('CUSTOM', CUSTOM, platform));
+console.log(lines.join('\n'));
@@ -0,0 +1,1232 @@
+#include <math.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <pebble.h>
+
+// Host implementation of the Pebble SDK subset in pebble.h. Drawing calls
+// are always counted, and rasterized into the framebuffer while
+// mock_render_window() draws the layer tree. Text is not rasterized, there
+// are no fonts, and nothing is antialiased.
+
+MockStats mock_stats;
+int32_t mock_live[MockObjectCount];
+int32_t mock_live_min[MockObjectCount];
+
+const char *const MOCK_OBJECT_NAMES[MockObjectCount] = {
+  "windows",
+  "layers",
+  "text_layers",
+  "bitmaps",
+  "bitmap_data",
+  "fonts",
+  "timers",
+};
+
+struct Layer {
+  GRect frame;
+  bool hidden;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  // Children draw in list order, the last one on top
+  Layer *first_child;
+  Layer *next_sibling;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+};
+
+struct Window {
+  Layer root;
+  WindowHandlers handlers;
+  bool loaded;
+};
+
+struct GBitmap {
+  GBitmapFormat format;
+  GRect bounds;
+  uint16_t row_bytes;
+  uint8_t *data;
+  GColor *palette;
+  bool owns_data;
+};
+
+struct GContext {
+  GBitmap frame_buffer;
+  // Only mock_render_window() draws, other contexts just count
+  bool rasterize;
+  GColor fill_color;
+  GColor stroke_color;
+  uint8_t stroke_width;
+  GCompOp compositing_mode;
+  // Screen position of the layer being drawn, and the part of the screen it may touch
+  GPoint offset;
+  GRect clip;
+};
+
+struct AppTimer {
+  uint64_t due_ms;
+  AppTimerCallback callback;
+  void *data;
+  AppTimer *next;
+};
+
+// Allocation header that lets the mock heap know what it frees
+typedef struct {
+  size_t size;
+} HeapBlock;
+
+static AppTimer *s_timers;
+static uint64_t s_timer_clock_ms;
+static GContext s_context;
+static uint8_t s_pixels[PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT];
+
+
+
+static void *mock_alloc(MockObject object, size_t size) {
+  HeapBlock *block = calloc(1, sizeof(HeapBlock) + size);
+  if (!block) {
+    return NULL;
+  }
+  block->size = size;
+  mock_live[object]++;
+  mock_stats.allocations++;
+  mock_stats.heap_used += size;
+  if (mock_stats.heap_used > mock_stats.heap_peak) {
+    mock_stats.heap_peak = mock_stats.heap_used;
+  }
+  return block + 1;
+}
+
+
+
+static void mock_free(MockObject object, void *pointer) {
+  if (!pointer) {
+    return;
+  }
+  if (--mock_live[object] < mock_live_min[object]) {
+    mock_live_min[object] = mock_live[object];
+  }
+  HeapBlock *block = (HeapBlock *)pointer - 1;
+  mock_stats.frees++;
+  mock_stats.heap_used -= block->size;
+  free(block);
+}
+
+
+
+void mock_reset_stats(void) {
+  size_t heap_used = mock_stats.heap_used;
+  memset(&mock_stats, 0, sizeof(mock_stats));
+  mock_stats.heap_used = heap_used;
+  mock_stats.heap_peak = heap_used;
+}
+
+
+
+void app_log(uint8_t level, const char *file, int line, const char *fmt, ...) {
+  if (!getenv("MOCK_LOG")) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "%s:%d ", file, line);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+
+
+bool gcolor_equal(GColor8 a, GColor8 b) {
+  return a.argb == b.argb;
+}
+
+
+
+bool grect_contains_point(const GRect *rect, const GPoint *point) {
+  return point->x >= rect->origin.x && point->x < rect->origin.x + rect->size.w &&
+         point->y >= rect->origin.y && point->y < rect->origin.y + rect->size.h;
+}
+
+
+
+uint16_t time_ms(time_t *t, uint16_t *out_ms) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  uint16_t millis = now.tv_usec / 1000;
+  if (t) {
+    *t = now.tv_sec;
+  }
+  if (out_ms) {
+    *out_ms = millis;
+  }
+  return millis;
+}
+
+
+
+time_t time_start_of_today(void) {
+  time_t now = time(NULL);
+  struct tm *t = localtime(&now);
+  t->tm_hour = t->tm_min = t->tm_sec = 0;
+  return mktime(t);
+}
+
+
+
+bool clock_is_24h_style(void) {
+  return true;
+}
+
+
+
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t)lround(sin(2 * M_PI * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t)lround(cos(2 * M_PI * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+
+
+// Layers and windows
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = mock_alloc(MockObjectLayer, sizeof(Layer));
+  if (layer) {
+    layer->frame = frame;
+  }
+  return layer;
+}
+
+
+
+void layer_destroy(Layer *layer) {
+  if (layer) {
+    layer_remove_from_parent(layer);
+  }
+  mock_free(MockObjectLayer, layer);
+}
+
+
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+  Layer **link = &parent->first_child;
+  while (*link) {
+    link = &(*link)->next_sibling;
+  }
+  *link = child;
+  child->parent = parent;
+}
+
+
+
+void layer_insert_above_sibling(Layer *layer, Layer *sibling) {
+  layer_remove_from_parent(layer);
+  layer->next_sibling = sibling->next_sibling;
+  sibling->next_sibling = layer;
+  layer->parent = sibling->parent;
+}
+
+
+
+void layer_remove_from_parent(Layer *layer) {
+  if (!layer->parent) {
+    return;
+  }
+  for (Layer **link = &layer->parent->first_child; *link; link = &(*link)->next_sibling) {
+    if (*link == layer) {
+      *link = layer->next_sibling;
+      break;
+    }
+  }
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+}
+
+
+
+void layer_mark_dirty(Layer *layer) {
+  mock_stats.dirty_marks++;
+}
+
+
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  layer->hidden = hidden;
+}
+
+
+
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = mock_alloc(MockObjectTextLayer, sizeof(TextLayer));
+  if (text_layer) {
+    text_layer->layer.frame = frame;
+  }
+  return text_layer;
+}
+
+
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (text_layer) {
+    layer_remove_from_parent(&text_layer->layer);
+  }
+  mock_free(MockObjectTextLayer, text_layer);
+}
+
+
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  mock_stats.dirty_marks++;
+}
+
+
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {}
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment) {}
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {}
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {}
+
+
+
+Window *window_create(void) {
+  Window *window = mock_alloc(MockObjectWindow, sizeof(Window));
+  if (window) {
+    window->root.frame = GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  }
+  return window;
+}
+
+
+
+void window_destroy(Window *window) {
+  if (window->loaded && window->handlers.unload) {
+    window->handlers.unload(window);
+  }
+  mock_free(MockObjectWindow, window);
+}
+
+
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root;
+}
+
+
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+
+
+void window_stack_push(Window *window, bool animated) {
+  if (!window->loaded && window->handlers.load) {
+    window->handlers.load(window);
+  }
+  window->loaded = true;
+}
+
+
+
+bool window_stack_remove(Window *window, bool animated) {
+  if (window->loaded && window->handlers.unload) {
+    window->handlers.unload(window);
+  }
+  window->loaded = false;
+  return true;
+}
+
+
+
+void app_event_loop(void) {}
+
+
+
+// Graphics, counted like the RENDER_STATS wrappers count them on the watch
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  mock_stats.state_changes++;
+  ctx->fill_color = color;
+}
+
+
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  mock_stats.state_changes++;
+  ctx->stroke_color = color;
+}
+
+
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width) {
+  mock_stats.state_changes++;
+  ctx->stroke_width = stroke_width;
+}
+
+
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  mock_stats.state_changes++;
+  ctx->compositing_mode = mode;
+}
+
+
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) { mock_stats.state_changes++; }
+void graphics_context_set_antialiased(GContext *ctx, bool enable) { mock_stats.state_changes++; }
+
+
+
+// Paint one pixel, in the coordinates of the layer being drawn. Black and
+// white displays show both grays as a 50% checkerboard.
+static void plot(GContext *ctx, int x, int y, GColor color) {
+  GPoint point = GPoint(ctx->offset.x + x, ctx->offset.y + y);
+  if (color.a == 0 || !grect_contains_point(&ctx->clip, &point)) {
+    return;
+  }
+  GBitmap *frame_buffer = &ctx->frame_buffer;
+#if defined(PBL_BW)
+  int level = (color.r + color.g + color.b + 1) / 3;
+  bool white = level == 3 || (level > 0 && (point.x + point.y) % 2 == 0);
+  uint8_t *byte = frame_buffer->data + point.y * frame_buffer->row_bytes + point.x / 8;
+  if (white) {
+    *byte |= 1 << point.x % 8;
+  } else {
+    *byte &= ~(1 << point.x % 8);
+  }
+#else
+  frame_buffer->data[point.y * frame_buffer->row_bytes + point.x] = color.argb | 0xC0;
+#endif
+}
+
+
+
+// Filled disc, the shape fill_circle and thick strokes share
+static void plot_disc(GContext *ctx, int cx, int cy, int radius, GColor color) {
+  for (int dy = -radius; dy <= radius; ++dy) {
+    for (int dx = -radius; dx <= radius; ++dx) {
+      if (dx * dx + dy * dy <= radius * radius + radius) {
+        plot(ctx, cx + dx, cy + dy, color);
+      }
+    }
+  }
+}
+
+
+
+// One point of a stroke, a disc as wide as the stroke
+static void plot_stroke(GContext *ctx, int x, int y) {
+  if (ctx->stroke_width <= 1) {
+    plot(ctx, x, y, ctx->stroke_color);
+  } else {
+    plot_disc(ctx, x, y, ctx->stroke_width / 2, ctx->stroke_color);
+  }
+}
+
+
+
+// Is a pixel inside the ring of the given center radius and width
+static bool in_ring(double dx, double dy, double radius, double width) {
+  double distance = sqrt(dx * dx + dy * dy);
+  return distance >= radius - width / 2 && distance < radius + width / 2;
+}
+
+
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  mock_stats.ops++;
+  if (!ctx->rasterize) {
+    return;
+  }
+  int r = corner_radius;
+  for (int y = 0; y < rect.size.h; ++y) {
+    for (int x = 0; x < rect.size.w; ++x) {
+      // Outside a rounded corner: top left, top right, bottom left, bottom right
+      int dx = x < r ? r - x : x >= rect.size.w - r ? x - (rect.size.w - r - 1) : 0;
+      int dy = y < r ? r - y : y >= rect.size.h - r ? y - (rect.size.h - r - 1) : 0;
+      int corner = (y < r ? 0 : 2) + (x < r ? 0 : 1);
+      if (dx && dy && (corner_mask & (1 << corner)) && dx * dx + dy * dy > r * r) {
+        continue;
+      }
+      plot(ctx, rect.origin.x + x, rect.origin.y + y, ctx->fill_color);
+    }
+  }
+}
+
+
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  mock_stats.ops++;
+  if (!ctx->rasterize) {
+    return;
+  }
+  // Bresenham
+  int dx = abs(p1.x - p0.x), sx = p0.x < p1.x ? 1 : -1;
+  int dy = -abs(p1.y - p0.y), sy = p0.y < p1.y ? 1 : -1;
+  int error = dx + dy;
+  int x = p0.x, y = p0.y;
+  while (true) {
+    plot_stroke(ctx, x, y);
+    if (x == p1.x && y == p1.y) {
+      break;
+    }
+    int doubled = 2 * error;
+    if (doubled >= dy) {
+      error += dy;
+      x += sx;
+    }
+    if (doubled <= dx) {
+      error += dx;
+      y += sy;
+    }
+  }
+}
+
+
+
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  mock_stats.ops++;
+  if (!ctx->rasterize) {
+    return;
+  }
+  // The stroke is centered on the radius
+  int extent = radius + ctx->stroke_width / 2 + 1;
+  double width = ctx->stroke_width > 1 ? ctx->stroke_width : 1;
+  for (int dy = -extent; dy <= extent; ++dy) {
+    for (int dx = -extent; dx <= extent; ++dx) {
+      if (in_ring(dx, dy, radius, width)) {
+        plot(ctx, p.x + dx, p.y + dy, ctx->stroke_color);
+      }
+    }
+  }
+}
+
+
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  mock_stats.ops++;
+  if (ctx->rasterize) {
+    plot_disc(ctx, p.x, p.y, radius, ctx->fill_color);
+  }
+}
+
+
+
+void graphics_draw_arc(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, int32_t angle_start,
+                       int32_t angle_end) {
+  mock_stats.ops++;
+  if (!ctx->rasterize) {
+    return;
+  }
+  // The stroke runs inside the rect, angles go clockwise from 12 o'clock
+  double cx = rect.origin.x + (rect.size.w - 1) / 2.0;
+  double cy = rect.origin.y + (rect.size.h - 1) / 2.0;
+  int diameter = rect.size.w < rect.size.h ? rect.size.w : rect.size.h;
+  double width = ctx->stroke_width > 1 ? ctx->stroke_width : 1;
+  double radius = diameter / 2.0 - width / 2;
+  for (int y = rect.origin.y; y < rect.origin.y + rect.size.h; ++y) {
+    for (int x = rect.origin.x; x < rect.origin.x + rect.size.w; ++x) {
+      double dx = x - cx, dy = y - cy;
+      if (!in_ring(dx, dy, radius, width)) {
+        continue;
+      }
+      double turn = atan2(dx, -dy) / (2 * M_PI);
+      int32_t angle = (int32_t)((turn < 0 ? turn + 1 : turn) * TRIG_MAX_ANGLE);
+      if (angle >= angle_start && angle <= angle_end) {
+        plot(ctx, x, y, ctx->stroke_color);
+      }
+    }
+  }
+}
+
+
+
+// Color of pixel x, y of a bitmap, relative to its bounds. Palettized rows
+// are packed most significant bits first, 1-bit rows least significant first.
+static GColor bitmap_pixel(const GBitmap *bitmap, int x, int y) {
+  x += bitmap->bounds.origin.x;
+  y += bitmap->bounds.origin.y;
+  const uint8_t *row = bitmap->data + y * bitmap->row_bytes;
+  switch (bitmap->format) {
+    case GBitmapFormat1Bit:
+      return (row[x / 8] >> x % 8) & 1 ? GColorWhite : GColorBlack;
+    case GBitmapFormat1BitPalette:
+      return bitmap->palette[(row[x / 8] >> (7 - x % 8)) & 0x1];
+    case GBitmapFormat2BitPalette:
+      return bitmap->palette[(row[x / 4] >> (6 - 2 * (x % 4))) & 0x3];
+    case GBitmapFormat4BitPalette:
+      return bitmap->palette[(row[x / 2] >> (4 - 4 * (x % 2))) & 0xF];
+    default:
+      return (GColor){ .argb = row[x] };
+  }
+}
+
+
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  mock_stats.ops++;
+  if (!ctx->rasterize) {
+    return;
+  }
+  // A bitmap smaller than the rect is tiled
+  GSize size = bitmap->bounds.size;
+  for (int y = 0; y < rect.size.h; ++y) {
+    for (int x = 0; x < rect.size.w; ++x) {
+      GColor color = bitmap_pixel(bitmap, x % size.w, y % size.h);
+      bool white = gcolor_equal(color, GColorWhite);
+      int px = rect.origin.x + x, py = rect.origin.y + y;
+      if (bitmap->format != GBitmapFormat1Bit) {
+        // Color sources are blended by their alpha whatever the mode
+        plot(ctx, px, py, color);
+        continue;
+      }
+      switch (ctx->compositing_mode) {
+        case GCompOpAssign:
+          plot(ctx, px, py, color);
+          break;
+        case GCompOpAssignInverted:
+          plot(ctx, px, py, white ? GColorBlack : GColorWhite);
+          break;
+        case GCompOpOr:
+          if (white) {
+            plot(ctx, px, py, GColorWhite);
+          }
+          break;
+        case GCompOpAnd:
+          if (!white) {
+            plot(ctx, px, py, GColorBlack);
+          }
+          break;
+        case GCompOpClear:
+          if (white) {
+            plot(ctx, px, py, GColorBlack);
+          }
+          break;
+        case GCompOpSet:
+          if (!white) {
+            plot(ctx, px, py, GColorWhite);
+          }
+          break;
+      }
+    }
+  }
+}
+
+
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        GTextAttributes *text_attributes) {
+  mock_stats.ops++;
+}
+
+
+
+static uint16_t row_bytes(GSize size, GBitmapFormat format) {
+  switch (format) {
+    case GBitmapFormat1Bit:
+      // Word aligned, like the watch
+      return (size.w + 31) / 32 * 4;
+    case GBitmapFormat1BitPalette:
+      return (size.w + 7) / 8;
+    case GBitmapFormat2BitPalette:
+      return (size.w + 3) / 4;
+    case GBitmapFormat4BitPalette:
+      return (size.w + 1) / 2;
+    default:
+      return size.w;
+  }
+}
+
+
+
+// Back to the state every layer starts drawing in
+static void reset_context(GContext *ctx, bool rasterize) {
+  GBitmap *frame_buffer = &ctx->frame_buffer;
+  frame_buffer->bounds = GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+#if defined(PBL_BW)
+  frame_buffer->format = GBitmapFormat1Bit;
+#else
+  frame_buffer->format = GBitmapFormat8Bit;
+#endif
+  frame_buffer->row_bytes = row_bytes(frame_buffer->bounds.size, frame_buffer->format);
+  frame_buffer->data = s_pixels;
+  ctx->rasterize = rasterize;
+  ctx->fill_color = GColorBlack;
+  ctx->stroke_color = GColorBlack;
+  ctx->stroke_width = 1;
+  ctx->compositing_mode = GCompOpAssign;
+  ctx->offset = GPointZero;
+  ctx->clip = frame_buffer->bounds;
+}
+
+
+
+GContext *mock_context(void) {
+  reset_context(&s_context, false);
+  return &s_context;
+}
+
+
+
+// Overlap of two rects, empty if they don't meet
+static GRect intersect(GRect a, GRect b) {
+  int left = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  int top = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  int right = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+  int bottom = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+  return GRect(left, top, right > left ? right - left : 0, bottom > top ? bottom - top : 0);
+}
+
+
+
+// Draw a layer and then its children on top, each clipped to its frame
+static void render_layer(Layer *layer, GPoint origin, GRect clip) {
+  if (layer->hidden) {
+    return;
+  }
+  GPoint offset = GPoint(origin.x + layer->frame.origin.x, origin.y + layer->frame.origin.y);
+  clip = intersect(clip, (GRect){ offset, layer->frame.size });
+  if (layer->update_proc) {
+    reset_context(&s_context, true);
+    s_context.offset = offset;
+    s_context.clip = clip;
+    layer->update_proc(layer, &s_context);
+  }
+  for (Layer *child = layer->first_child; child; child = child->next_sibling) {
+    render_layer(child, offset, clip);
+  }
+}
+
+
+
+GContext *mock_render_window(Window *window) {
+  reset_context(&s_context, true);
+  // Windows are white unless they set a background color
+  for (int y = 0; y < PBL_DISPLAY_HEIGHT; ++y) {
+    for (int x = 0; x < PBL_DISPLAY_WIDTH; ++x) {
+      plot(&s_context, x, y, GColorWhite);
+    }
+  }
+  render_layer(&window->root, GPointZero, s_context.frame_buffer.bounds);
+  reset_context(&s_context, false);
+  return &s_context;
+}
+
+
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  return &ctx->frame_buffer;
+}
+
+
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  return true;
+}
+
+
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  GBitmap *bitmap = mock_alloc(MockObjectBitmap, sizeof(GBitmap));
+  if (!bitmap) {
+    return NULL;
+  }
+  bitmap->format = format;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->row_bytes = row_bytes(size, format);
+  bitmap->data = mock_alloc(MockObjectBitmapData, bitmap->row_bytes * size.h);
+  bitmap->owns_data = true;
+  return bitmap;
+}
+
+
+
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format, GColor *palette,
+                                           bool free_on_destroy) {
+  GBitmap *bitmap = gbitmap_create_blank(size, format);
+  if (bitmap) {
+    bitmap->palette = palette;
+  }
+  return bitmap;
+}
+
+
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  // Every image resource is the digit atlas, two colors
+  static GColor s_palette[2];
+  GBitmap *bitmap = gbitmap_create_blank(GSize(256, 32), GBitmapFormat1BitPalette);
+  if (bitmap) {
+    bitmap->palette = s_palette;
+  }
+  return bitmap;
+}
+
+
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect) {
+  GBitmap *bitmap = mock_alloc(MockObjectBitmap, sizeof(GBitmap));
+  if (bitmap) {
+    *bitmap = *base_bitmap;
+    bitmap->bounds = sub_rect;
+    bitmap->owns_data = false;
+  }
+  return bitmap;
+}
+
+
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap && bitmap->owns_data) {
+    mock_free(MockObjectBitmapData, bitmap->data);
+  }
+  mock_free(MockObjectBitmap, bitmap);
+}
+
+
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->row_bytes;
+}
+
+
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+  return (GBitmapDataRowInfo) {
+    .data = bitmap->data + y * bitmap->row_bytes,
+    .min_x = 0,
+    .max_x = bitmap->bounds.size.w - 1,
+  };
+}
+
+
+
+GColor *gbitmap_get_palette(const GBitmap *bitmap) {
+  return bitmap->palette;
+}
+
+
+
+GFont fonts_get_system_font(const char *font_key) {
+  return (GFont)font_key;
+}
+
+
+
+GFont fonts_load_custom_font(ResHandle handle) {
+  return mock_alloc(MockObjectFont, 64);
+}
+
+
+
+void fonts_unload_custom_font(GFont font) {
+  mock_free(MockObjectFont, font);
+}
+
+
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle)(uintptr_t)resource_id;
+}
+
+
+
+// Services
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  AppTimer *timer = mock_alloc(MockObjectTimer, sizeof(AppTimer));
+  if (timer) {
+    timer->due_ms = s_timer_clock_ms + timeout_ms;
+    timer->callback = callback;
+    timer->data = callback_data;
+    timer->next = s_timers;
+    s_timers = timer;
+  }
+  return timer;
+}
+
+
+
+static bool unlink_timer(AppTimer *timer) {
+  for (AppTimer **link = &s_timers; *link; link = &(*link)->next) {
+    if (*link == timer) {
+      *link = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms) {
+  for (AppTimer *t = s_timers; t; t = t->next) {
+    if (t == timer) {
+      t->due_ms = s_timer_clock_ms + new_timeout_ms;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+
+void app_timer_cancel(AppTimer *timer) {
+  if (unlink_timer(timer)) {
+    mock_free(MockObjectTimer, timer);
+  }
+}
+
+
+
+void mock_run_timers(uint32_t ms) {
+  s_timer_clock_ms += ms;
+  bool fired = true;
+  while (fired) {
+    fired = false;
+    for (AppTimer *timer = s_timers; timer; timer = timer->next) {
+      if (timer->due_ms <= s_timer_clock_ms) {
+        unlink_timer(timer);
+        AppTimerCallback callback = timer->callback;
+        void *data = timer->data;
+        mock_free(MockObjectTimer, timer);
+        callback(data);
+        // The callback may have changed the list
+        fired = true;
+        break;
+      }
+    }
+  }
+}
+
+
+
+void app_focus_service_subscribe(AppFocusHandler handler) {}
+void app_focus_service_unsubscribe(void) {}
+void accel_tap_service_subscribe(AccelTapHandler handler) {}
+void accel_tap_service_unsubscribe(void) {}
+void battery_state_service_subscribe(BatteryStateHandler handler) {}
+void battery_state_service_unsubscribe(void) {}
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {}
+void tick_timer_service_unsubscribe(void) {}
+
+
+
+BatteryChargeState battery_state_service_peek(void) {
+  return (BatteryChargeState) { .charge_percent = 80 };
+}
+
+
+
+#if defined(PBL_HEALTH)
+bool health_service_events_subscribe(HealthEventHandler handler, void *context) {
+  handler(HealthEventSignificantUpdate, context);
+  return true;
+}
+
+
+
+bool health_service_events_unsubscribe(void) {
+  return true;
+}
+
+
+
+HealthActivityMask health_service_peek_current_activities(void) {
+  return HealthActivityNone;
+}
+
+
+
+HealthValue health_service_sum_today(HealthMetric metric) {
+  return 4321;
+}
+
+
+
+HealthServiceAccessibilityMask health_service_metric_accessible(HealthMetric metric, time_t time_start,
+                                                                time_t time_end) {
+  return HealthServiceAccessibilityMaskAvailable;
+}
+#endif
+
+
+
+// Persistent storage, a handful of keys in memory
+
+#define MOCK_PERSIST_KEYS 8
+#define MOCK_PERSIST_SIZE 256
+
+static struct {
+  bool used;
+  uint32_t key;
+  size_t size;
+  uint8_t data[MOCK_PERSIST_SIZE];
+} s_persist[MOCK_PERSIST_KEYS];
+
+
+
+static int persist_slot(uint32_t key, bool create) {
+  for (int i = 0; i < MOCK_PERSIST_KEYS; ++i) {
+    if (s_persist[i].used && s_persist[i].key == key) {
+      return i;
+    }
+  }
+  for (int i = 0; create && i < MOCK_PERSIST_KEYS; ++i) {
+    if (!s_persist[i].used) {
+      s_persist[i].used = true;
+      s_persist[i].key = key;
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  int slot = persist_slot(key, false);
+  if (slot < 0) {
+    return -1;
+  }
+  size_t size = s_persist[slot].size < buffer_size ? s_persist[slot].size : buffer_size;
+  memcpy(buffer, s_persist[slot].data, size);
+  return size;
+}
+
+
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  int slot = persist_slot(key, true);
+  if (slot < 0 || size > MOCK_PERSIST_SIZE) {
+    return -1;
+  }
+  memcpy(s_persist[slot].data, data, size);
+  s_persist[slot].size = size;
+  mock_stats.flash_writes++;
+  return size;
+}
+
+
+
+bool persist_exists(const uint32_t key) {
+  return persist_slot(key, false) >= 0;
+}
+
+
+
+int persist_get_size(const uint32_t key) {
+  int slot = persist_slot(key, false);
+  return slot < 0 ? -1 : (int)s_persist[slot].size;
+}
+
+
+
+int persist_delete(const uint32_t key) {
+  int slot = persist_slot(key, false);
+  if (slot >= 0) {
+    s_persist[slot].used = false;
+  }
+  return 0;
+}
+
+
+
+void mock_clear_persist(void) {
+  memset(s_persist, 0, sizeof(s_persist));
+}
+
+
+
+size_t heap_bytes_used(void) {
+  return mock_stats.heap_used;
+}
+
+
+
+size_t heap_bytes_free(void) {
+  // Aplite's app heap, the smallest budget
+  return mock_stats.heap_used < 24576 ? 24576 - mock_stats.heap_used : 0;
+}
+
+
+
+// AppMessage and dictionaries, stored like the watch: a count byte, then tuples
+
+static uint8_t s_outbox[256];
+static DictionaryIterator s_outbox_iter;
+
+
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  return APP_MSG_OK;
+}
+
+
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  return NULL;
+}
+
+
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  return NULL;
+}
+
+
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  dict_write_begin(&s_outbox_iter, s_outbox, sizeof(s_outbox));
+  *iterator = &s_outbox_iter;
+  return APP_MSG_OK;
+}
+
+
+
+AppMessageResult app_message_outbox_send(void) {
+  dict_write_end(&s_outbox_iter);
+  return APP_MSG_OK;
+}
+
+
+
+uint32_t mock_sum_sizes(int count, ...) {
+  va_list args;
+  va_start(args, count);
+  uint32_t total = 0;
+  for (int i = 0; i < count; ++i) {
+    total += va_arg(args, size_t);
+  }
+  va_end(args);
+  return total;
+}
+
+
+
+int dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size) {
+  iter->buffer = buffer;
+  iter->end = buffer + size;
+  iter->cursor = buffer + 1;
+  buffer[0] = 0;
+  return 0;
+}
+
+
+
+static int dict_write(DictionaryIterator *iter, uint32_t key, uint8_t type, const void *data,
+                      uint16_t size) {
+  if (iter->cursor + sizeof(Tuple) + size > iter->end) {
+    return -1;
+  }
+  Tuple *tuple = (Tuple *)iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = size;
+  memcpy(tuple->value->data, data, size);
+  iter->cursor += sizeof(Tuple) + size;
+  iter->buffer[0]++;
+  return 0;
+}
+
+
+
+int dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data,
+                    const uint16_t size) {
+  return dict_write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+
+
+int dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+
+
+int dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+  return dict_write(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  iter->end = iter->cursor;
+  return iter->cursor - iter->buffer;
+}
+
+
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer,
+                                   const uint16_t size) {
+  iter->buffer = (uint8_t *)buffer;
+  iter->end = (uint8_t *)buffer + size;
+  iter->cursor = (uint8_t *)buffer + 1;
+  return buffer[0] ? (Tuple *)iter->cursor : NULL;
+}
+
+
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  uint8_t *cursor = iter->buffer + 1;
+  for (uint8_t i = 0; i < iter->buffer[0] && cursor < iter->end; ++i) {
+    Tuple *tuple = (Tuple *)cursor;
+    if (tuple->key == key) {
+      return tuple;
+    }
+    cursor += sizeof(Tuple) + tuple->length;
+  }
+  return NULL;
+}
@@ -0,0 +1,397 @@
+#pragma once
+
+// Just enough of the Pebble SDK to build src/*.c on a Linux host. Every
+// drawing call and context state change is counted, every Pebble object is
+// allocated from a tracked heap (see MockStats). The platform comes from
+// -DPBL_PLATFORM_<NAME>, see the Makefile.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(PBL_PLATFORM_APLITE)
+#define PBL_BW
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_BASALT)
+#define PBL_COLOR
+#define PBL_RECT
+#define PBL_HEALTH
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_CHALK)
+#define PBL_COLOR
+#define PBL_ROUND
+#define PBL_HEALTH
+#define PBL_DISPLAY_WIDTH 180
+#define PBL_DISPLAY_HEIGHT 180
+#elif defined(PBL_PLATFORM_DIORITE)
+#define PBL_BW
+#define PBL_RECT
+#define PBL_HEALTH
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_EMERY)
+#define PBL_COLOR
+#define PBL_RECT
+#define PBL_HEALTH
+#define PBL_DISPLAY_WIDTH 200
+#define PBL_DISPLAY_HEIGHT 228
+#else
+#error "Build with -DPBL_PLATFORM_APLITE, _BASALT, _CHALK, _DIORITE or _EMERY"
+#endif
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+#define TRIG_MAX_ANGLE 0x10000
+#define TRIG_MAX_RATIO 0xffff
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200
+} AppLogLevel;
+void app_log(uint8_t level, const char *file, int line, const char *fmt, ...)
+  __attribute__((format(printf, 4, 5)));
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ## __VA_ARGS__)
+
+// Graphics types
+
+typedef union GColor8 {
+  uint8_t argb;
+  struct {
+    uint8_t b:2;
+    uint8_t g:2;
+    uint8_t r:2;
+    uint8_t a:2;
+  };
+} GColor8;
+typedef GColor8 GColor;
+#define GColorBlackARGB8 ((uint8_t)0xC0)
+#define GColorWhiteARGB8 ((uint8_t)0xFF)
+#define GColorDarkGrayARGB8 ((uint8_t)0xD5)
+#define GColorLightGrayARGB8 ((uint8_t)0xEA)
+#define GColorBlack ((GColor8){ .argb = GColorBlackARGB8 })
+#define GColorWhite ((GColor8){ .argb = GColorWhiteARGB8 })
+#define GColorDarkGray ((GColor8){ .argb = GColorDarkGrayARGB8 })
+#define GColorLightGray ((GColor8){ .argb = GColorLightGrayARGB8 })
+#define GColorClear ((GColor8){ .argb = 0x00 })
+bool gcolor_equal(GColor8 a, GColor8 b);
+
+typedef struct GPoint {
+  int16_t x;
+  int16_t y;
+} GPoint;
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GPointZero GPoint(0, 0)
+
+typedef struct GSize {
+  int16_t w;
+  int16_t h;
+} GSize;
+#define GSize(w, h) ((GSize){ (w), (h) })
+
+typedef struct GRect {
+  GPoint origin;
+  GSize size;
+} GRect;
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+bool grect_contains_point(const GRect *rect, const GPoint *point);
+
+typedef enum {
+  GBitmapFormat1Bit,
+  GBitmapFormat8Bit,
+  GBitmapFormat1BitPalette,
+  GBitmapFormat2BitPalette,
+  GBitmapFormat4BitPalette,
+  GBitmapFormat8BitCircular
+} GBitmapFormat;
+
+typedef struct {
+  uint8_t *data;
+  int16_t min_x;
+  int16_t max_x;
+} GBitmapDataRowInfo;
+
+typedef enum { GCompOpAssign, GCompOpAssignInverted, GCompOpOr, GCompOpAnd, GCompOpClear, GCompOpSet } GCompOp;
+typedef enum { GCornerNone = 0, GCornersAll = 15 } GCornerMask;
+typedef enum { GOvalScaleModeFitCircle, GOvalScaleModeFillCircle } GOvalScaleMode;
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill
+} GTextOverflowMode;
+
+typedef struct GBitmap GBitmap;
+typedef struct GContext GContext;
+typedef struct GTextAttributes GTextAttributes;
+typedef struct FontInfo *GFont;
+typedef void *ResHandle;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+
+// Time
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5
+} TimeUnits;
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+uint16_t time_ms(time_t *t, uint16_t *out_ms);
+time_t time_start_of_today(void);
+bool clock_is_24h_style(void);
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+// Layers and windows
+
+typedef struct Layer Layer;
+typedef struct TextLayer TextLayer;
+typedef struct Window Window;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+typedef void (*WindowHandler)(Window *window);
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_insert_above_sibling(Layer *layer, Layer *sibling);
+void layer_remove_from_parent(Layer *layer);
+void layer_mark_dirty(Layer *layer);
+void layer_set_hidden(Layer *layer, bool hidden);
+bool layer_get_hidden(const Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+GRect layer_get_frame(const Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_stack_push(Window *window, bool animated);
+bool window_stack_remove(Window *window, bool animated);
+
+void app_event_loop(void);
+
+// Graphics
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_context_set_antialiased(GContext *ctx, bool enable);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_draw_arc(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, int32_t angle_start,
+                       int32_t angle_end);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        GTextAttributes *text_attributes);
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format);
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format, GColor *palette,
+                                           bool free_on_destroy);
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect);
+void gbitmap_destroy(GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y);
+GColor *gbitmap_get_palette(const GBitmap *bitmap);
+
+GFont fonts_get_system_font(const char *font_key);
+GFont fonts_load_custom_font(ResHandle handle);
+void fonts_unload_custom_font(GFont font);
+ResHandle resource_get_handle(uint32_t resource_id);
+
+// Services
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+
+typedef void (*AppFocusHandler)(bool in_focus);
+void app_focus_service_subscribe(AppFocusHandler handler);
+void app_focus_service_unsubscribe(void);
+
+typedef enum { ACCEL_AXIS_X, ACCEL_AXIS_Y, ACCEL_AXIS_Z } AccelAxisType;
+typedef void (*AccelTapHandler)(AccelAxisType axis, int32_t direction);
+void accel_tap_service_subscribe(AccelTapHandler handler);
+void accel_tap_service_unsubscribe(void);
+
+typedef struct {
+  uint8_t charge_percent;
+  bool is_charging;
+  bool is_plugged;
+} BatteryChargeState;
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+BatteryChargeState battery_state_service_peek(void);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+#if defined(PBL_HEALTH)
+typedef enum {
+  HealthEventSignificantUpdate,
+  HealthEventMovementUpdate,
+  HealthEventSleepUpdate,
+  HealthEventMetricAlert,
+  HealthEventHeartRateUpdate
+} HealthEventType;
+typedef enum {
+  HealthActivityNone = 0,
+  HealthActivitySleep = 1 << 0,
+  HealthActivityRestfulSleep = 1 << 1,
+  HealthActivityWalk = 1 << 2,
+  HealthActivityRun = 1 << 3
+} HealthActivity;
+typedef uint32_t HealthActivityMask;
+typedef enum { HealthMetricStepCount } HealthMetric;
+typedef int32_t HealthValue;
+typedef enum { HealthServiceAccessibilityMaskAvailable = 1 << 0 } HealthServiceAccessibilityMask;
+typedef void (*HealthEventHandler)(HealthEventType event, void *context);
+bool health_service_events_subscribe(HealthEventHandler handler, void *context);
+bool health_service_events_unsubscribe(void);
+HealthActivityMask health_service_peek_current_activities(void);
+HealthValue health_service_sum_today(HealthMetric metric);
+HealthServiceAccessibilityMask health_service_metric_accessible(HealthMetric metric, time_t time_start,
+                                                                time_t time_end);
+#endif
+
+// Persistent storage
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int persist_delete(const uint32_t key);
+
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+
+// AppMessage and dictionaries
+
+typedef enum { APP_MSG_OK = 0, APP_MSG_BUSY = 1 << 10 } AppMessageResult;
+typedef enum { TUPLE_BYTE_ARRAY = 0, TUPLE_CSTRING = 1, TUPLE_UINT = 2, TUPLE_INT = 3 } TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  uint8_t type;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    uint32_t uint32;
+    uint8_t uint8;
+  } value[];
+} Tuple;
+
+typedef struct {
+  uint8_t *buffer;
+  uint8_t *end;
+  uint8_t *cursor;
+} DictionaryIterator;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason,
+                                       void *context);
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+// Worst case size of a dictionary with count tuples of the given value sizes
+#define dict_calc_buffer_size(count, ...) \
+  (1 + (count) * (sizeof(Tuple)) + mock_sum_sizes(count, __VA_ARGS__))
+uint32_t mock_sum_sizes(int count, ...);
+int dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size);
+int dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data,
+                    const uint16_t size);
+int dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+int dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer,
+                                   const uint16_t size);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+// Generated from package.json (see generate.py)
+#include "message_keys.h"
+#include "resource_ids.h"
+
+// Host-only hooks for the benchmark and the tests
+
+// Counts since the last mock_reset_stats()
+typedef struct {
+  uint32_t ops;
+  uint32_t state_changes;
+  uint32_t allocations;
+  uint32_t frees;
+  uint32_t dirty_marks;
+  uint32_t flash_writes;
+  size_t heap_used;
+  size_t heap_peak;
+} MockStats;
+
+extern MockStats mock_stats;
+void mock_reset_stats(void);
+
+// Pebble objects on the mock heap, by the calls that create and destroy them
+typedef enum {
+  MockObjectWindow,
+  MockObjectLayer,
+  MockObjectTextLayer,
+  MockObjectBitmap,
+  MockObjectBitmapData,
+  MockObjectFont,
+  MockObjectTimer,
+  MockObjectCount
+} MockObject;
+
+extern const char *const MOCK_OBJECT_NAMES[MockObjectCount];
+// Live objects of each kind, and the lowest each count has been. Destroying
+// an object twice takes its count below zero.
+extern int32_t mock_live[MockObjectCount];
+extern int32_t mock_live_min[MockObjectCount];
+// A drawing context over a framebuffer the size of the display, that only counts
+GContext *mock_context(void);
+// Draw the window's layer tree into the framebuffer, returns the context to read it from
+GContext *mock_render_window(Window *window);
+// Run every timer that is due at the mock time, then advance it by ms
+void mock_run_timers(uint32_t ms);
+void mock_clear_persist(void);
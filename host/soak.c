@@ -0,0 +1,56 @@
+// Settings soak: runs the SETTINGS_SOAK build's random settings messages and
+// window reloads through main.c, drawing a frame after every batch, then
+// shuts the face down. Fails if the heap ends more than SOAK_HEAP_SLACK above
+// where the soak started, if any object was destroyed more often than it was
+// created, or if anything is still live after deinit.
+
+#define main pebble_main
+#include "../src/main.c"
+#undef main
+
+
+
+int main(void) {
+  mock_clear_persist();
+  init();
+  // The launch frame, the rest of startup, and the frame that caches the background
+  mock_render_window(s_window);
+  mock_run_timers(0);
+  mock_render_window(s_window);
+  size_t start_heap = heap_bytes_used();
+
+  // One batch of messages per timer, each followed by a frame like on the watch
+  mock_run_timers(SIM_START_DELAY_MS);
+  while (s_soak_sent < SOAK_MESSAGES) {
+    mock_render_window(s_window);
+    mock_run_timers(SOAK_INTERVAL_MS);
+  }
+  // The original settings are back, their frame, then the watch's own report
+  mock_render_window(s_window);
+  mock_run_timers(SOAK_INTERVAL_MS);
+  size_t end_heap = heap_bytes_used();
+  bool passed = end_heap <= start_heap + SOAK_HEAP_SLACK;
+  printf("%s: soak messages=%lu heap start=%lu end=%lu slack=%d peak=%lu\n", HOST_PLATFORM,
+         (unsigned long)s_soak_sent, (unsigned long)start_heap, (unsigned long)end_heap,
+         SOAK_HEAP_SLACK, (unsigned long)mock_stats.heap_peak);
+  if (!passed) {
+    printf("%s: soak heap grew by %lu, more than the slack\n", HOST_PLATFORM,
+           (unsigned long)(end_heap - start_heap));
+  }
+
+  deinit();
+  for (int i = 0; i < MockObjectCount; ++i) {
+    if (mock_live_min[i] < 0) {
+      printf("%s: soak destroyed %ld more %s than were created\n", HOST_PLATFORM,
+             (long)-mock_live_min[i], MOCK_OBJECT_NAMES[i]);
+      passed = false;
+    }
+    if (mock_live[i] != 0) {
+      printf("%s: soak left %ld %s live after deinit\n", HOST_PLATFORM, (long)mock_live[i],
+             MOCK_OBJECT_NAMES[i]);
+      passed = false;
+    }
+  }
+  printf("%s: soak %s\n", HOST_PLATFORM, passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
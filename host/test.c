@@ -0,0 +1,220 @@
+// Tests for the settings code in main.c that does not need a watch: color
+// packing, the settings message, its hash against src/js/settings.js, and
+// the persisted settings including the migration of 1.0 settings.
+
+#define main pebble_main
+#include "../src/main.c"
+#undef main
+
+#include "js_vectors.h"
+
+static int s_checks;
+static int s_failures;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+
+
+// Count a check, and print it if it failed
+static void check(bool passed, const char *condition, int line) {
+  s_checks++;
+  if (!passed) {
+    s_failures++;
+    printf("%s: test.c:%d: %s\n", HOST_PLATFORM, line, condition);
+  }
+}
+
+
+
+#if defined(PBL_COLOR)
+// Every rgb value round trips at every index, without touching the others
+static void test_pack_colors() {
+  for (int index = 0; index < NUM_SETTINGS_COLORS; ++index) {
+    for (int rgb = 0; rgb < 64; ++rgb) {
+      uint8_t packed[NUM_SETTINGS_COLORS * 6 / 8] = { 0 };
+      // Alpha bits must not leak into the neighbours
+      pack_color(packed, index, (GColor){ .argb = 0xC0 | rgb });
+      CHECK(unpack_color(packed, index).argb == (0xC0 | rgb));
+      for (int other = 0; other < NUM_SETTINGS_COLORS; ++other) {
+        if (other != index) {
+          CHECK(unpack_color(packed, other).argb == 0xC0);
+        }
+      }
+    }
+  }
+
+  // All of them at once, each a different color
+  uint8_t packed[NUM_SETTINGS_COLORS * 6 / 8] = { 0 };
+  for (int index = 0; index < NUM_SETTINGS_COLORS; ++index) {
+    pack_color(packed, index, (GColor){ .argb = 0xC0 | (index * 7 + 5) % 64 });
+  }
+  for (int index = 0; index < NUM_SETTINGS_COLORS; ++index) {
+    CHECK(unpack_color(packed, index).argb == (0xC0 | (index * 7 + 5) % 64));
+  }
+}
+#endif
+
+
+
+// The settings message is validated and applied field by field
+static void test_decode_settings_message() {
+  uint8_t message[SETTINGS_MESSAGE_SIZE + 4];
+  default_settings();
+  encode_settings_message(message);
+  ClaySettings defaults = settings;
+
+  // Only the version we know
+  message[0] = SETTINGS_MESSAGE_VERSION + 1;
+  message[1] = 'a';
+  CHECK(!decode_settings_message(message, SETTINGS_MESSAGE_SIZE));
+  CHECK(!decode_settings_message(message, 0));
+  CHECK(memcmp(&settings, &defaults, sizeof(settings)) == 0);
+
+  // Older phones send fewer fields, the rest keep their values
+  message[0] = SETTINGS_MESSAGE_VERSION;
+  message[2] = 0x31;
+  message[3] = GColorBlack.argb;
+  CHECK(decode_settings_message(message, 3));
+  CHECK(settings.SelectClock == 'a');
+#if defined(PBL_COLOR)
+  // Colors always come out opaque
+  CHECK(settings.LeftStripeColor.argb == 0xF1);
+  CHECK(gcolor_equal(settings.RightStripeColor, defaults.RightStripeColor));
+#else
+  // No color settings on black and white, the default color goes back out
+  uint8_t sent[SETTINGS_MESSAGE_SIZE];
+  encode_settings_message(sent);
+  CHECK(sent[2] == DEFAULT_LeftStripeColor);
+#endif
+
+  // Newer phones send more, the extra fields are ignored
+  memset(message + SETTINGS_MESSAGE_SIZE, 0xFF, sizeof(message) - SETTINGS_MESSAGE_SIZE);
+  default_settings();
+  encode_settings_message(message);
+  CHECK(decode_settings_message(message, sizeof(message)));
+  CHECK(memcmp(&settings, &defaults, sizeof(settings)) == 0);
+
+  // Any nonzero byte is true
+  message[1 + 9] = 7;
+  CHECK(decode_settings_message(message, SETTINGS_MESSAGE_SIZE));
+  CHECK(settings.InvertOutline == true);
+  uint8_t encoded[SETTINGS_MESSAGE_SIZE];
+  encode_settings_message(encoded);
+  CHECK(encoded[1 + 9] == 1);
+}
+
+
+
+// Settings survive a save and load, records of another size or version do not
+static void test_persisted_settings() {
+  mock_clear_persist();
+  memset(&s_persisted, 0, sizeof(s_persisted));
+  default_settings();
+  settings.SelectClock = 'a';
+  settings.SweepFps = 15;
+  settings.QuietEnd = 6;
+  ClaySettings saved = settings;
+  save_settings();
+  load_settings();
+  CHECK(memcmp(&settings, &saved, sizeof(settings)) == 0);
+
+  PersistedSettings persisted = s_persisted;
+  persist_write_data(SETTINGS_BLOB_KEY, &persisted, sizeof(persisted) - 1);
+  load_settings();
+  CHECK(settings.SelectClock == 'd');
+  persisted.version = SETTINGS_SCHEMA_VERSION + 1;
+  persist_write_data(SETTINGS_BLOB_KEY, &persisted, sizeof(persisted));
+  load_settings();
+  CHECK(settings.SweepFps == 10);
+}
+
+
+
+// Only a whole 1.0 record is migrated, and only once
+static void test_migrate_legacy_settings() {
+  LegacySettings legacy = {
+    .SelectClock = 'a',
+    .HandsColor = { .argb = 0xCB },
+    .BatteryBarToggle = false,
+    .HourDots = true,
+  };
+  mock_clear_persist();
+  persist_write_data(SETTINGS_KEY, &legacy, sizeof(legacy));
+  load_settings();
+  CHECK(settings.SelectClock == 'a');
+  CHECK(settings.BatteryBarToggle == false);
+  CHECK(!persist_exists(SETTINGS_KEY));
+  CHECK(persist_exists(SETTINGS_BLOB_KEY));
+
+  // Any other size is not a layout that shipped
+  uint8_t longer[sizeof(legacy) + 7] = { 'a' };
+  mock_clear_persist();
+  memset(&s_persisted, 0, sizeof(s_persisted));
+  persist_write_data(SETTINGS_KEY, longer, sizeof(longer));
+  load_settings();
+  CHECK(settings.SelectClock == 'd');
+  CHECK(!persist_exists(SETTINGS_KEY));
+  CHECK(!persist_exists(SETTINGS_BLOB_KEY));
+}
+
+
+
+// Same values as CUSTOM in js_vectors.js, colors as the GColor8 they round to
+static void custom_settings() {
+  default_settings();
+  settings.SelectClock = 'a';
+#if defined(PBL_COLOR)
+  settings.LeftStripeColor = (GColor){ .argb = 0xF1 };
+  settings.HandsColor = (GColor){ .argb = 0xCB };
+  settings.SecondHandColor = (GColor){ .argb = 0xF8 };
+#endif
+  settings.BatteryBarToggle = false;
+  settings.SecondsTimeout = 45;
+  settings.NightMode = true;
+  settings.QuietStart = 22;
+  settings.SweepSeconds = true;
+  settings.SweepFps = 15;
+  settings.StepsComplication = true;
+}
+
+
+
+// The watch and the phone agree on the message bytes and their hash
+static void test_settings_hash() {
+  // FNV-1a reference values
+  CHECK(settings_hash((const uint8_t *)"", 0) == 0x811C9DC5u);
+  CHECK(settings_hash((const uint8_t *)"a", 1) == 0xE40C292Cu);
+  CHECK(settings_hash((const uint8_t *)"foobar", 6) == 0xBF9CF968u);
+
+  uint8_t message[SETTINGS_MESSAGE_SIZE];
+  CHECK(sizeof(message) == sizeof(JS_DEFAULT_MESSAGE));
+
+  default_settings();
+  encode_settings_message(message);
+  CHECK(memcmp(message, JS_DEFAULT_MESSAGE, sizeof(message)) == 0);
+  update_settings_hash();
+  CHECK(s_settings_hash == JS_DEFAULT_HASH);
+
+  custom_settings();
+  encode_settings_message(message);
+  CHECK(memcmp(message, JS_CUSTOM_MESSAGE, sizeof(message)) == 0);
+  update_settings_hash();
+  CHECK(s_settings_hash == JS_CUSTOM_HASH);
+
+  // What the phone sends hashes the same on the watch, so it is not applied twice
+  CHECK(settings_hash(JS_CUSTOM_MESSAGE, sizeof(JS_CUSTOM_MESSAGE)) == JS_CUSTOM_HASH);
+}
+
+
+
+int main(void) {
+#if defined(PBL_COLOR)
+  test_pack_colors();
+#endif
+  test_decode_settings_message();
+  test_persisted_settings();
+  test_migrate_legacy_settings();
+  test_settings_hash();
+  printf("%s: %d checks, %d failed\n", HOST_PLATFORM, s_checks, s_failures);
+  return s_failures ? 1 : 0;
+}
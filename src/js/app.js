@@ -1,3 +1,69 @@
 var Clay = require('pebble-clay');
 var clayConfig = require('./config');
-var clay = new Clay(clayConfig);
\ No newline at end of file
+var settings = require('./settings');
+// Settings are sent by hand as one packed message (see settings.js)
+var clay = new Clay(clayConfig, null, { autoHandleEvents: false });
+
+// Hash of the settings the watch last reported or received from us
+var watchHash = null;
+
+// Platform of the connected watch, colors are encoded differently for black and white
+function watchPlatform() {
+  var info = Pebble.getActiveWatchInfo ? Pebble.getActiveWatchInfo() : null;
+  return info ? info.platform : 'aplite';
+}
+
+// Settings Clay saved on the phone, keyed by messageKey name
+function storedSettings() {
+  try {
+    return JSON.parse(localStorage.getItem('clay-settings')) || {};
+  } catch (err) {
+    return {};
+  }
+}
+
+// Send the settings unless the watch already has exactly these
+function sendSettings(values) {
+  var bytes = settings.encode(values, clayConfig, watchPlatform());
+  var hash = settings.hash(bytes);
+  if (hash === watchHash) {
+    return;
+  }
+
+  Pebble.sendAppMessage({ SettingsBlob: bytes }, function() {
+    watchHash = hash;
+    console.log('Settings sent');
+  }, function(error) {
+    console.log('Failed to send settings: ' + JSON.stringify(error));
+  });
+}
+
+Pebble.addEventListener('showConfiguration', function() {
+  Pebble.openURL(clay.generateUrl());
+});
+
+Pebble.addEventListener('webviewclosed', function(e) {
+  if (!e || !e.response) {
+    return;
+  }
+
+  // Settings keyed by messageKey name, colors still as 0xRRGGBB
+  sendSettings(clay.getSettings(e.response, false));
+});
+
+// On launch the watch reports the hash of what it has
+Pebble.addEventListener('appmessage', function(e) {
+  var payload = e.payload;
+  if (payload.SettingsHash === undefined) {
+    return;
+  }
+
+  // A watch on another message version always gets a fresh copy
+  watchHash = payload.SettingsVersion === settings.VERSION ? payload.SettingsHash >>> 0 : null;
+  // Nothing saved on this phone yet (new phone, reinstall, cleared storage):
+  // the watch keeps its own settings rather than getting the defaults
+  if (localStorage.getItem('clay-settings') === null) {
+    return;
+  }
+  sendSettings(storedSettings());
+});
@@ -29,11 +29,46 @@ module.exports = [
             "value": 'a'
           }
         ]
+      },
+      {
+        "type": "toggle",
+        "messageKey": "AdaptiveSeconds",
+        "defaultValue": false,
+        "label": "Power Saving Second Hand (Analog)",
+        "description": "Hides the second hand until you flick your wrist"
+      },
+      {
+        "type": "slider",
+        "messageKey": "SecondsTimeout",
+        "defaultValue": 30,
+        "label": "Show Second Hand For (seconds)",
+        "min": 5,
+        "max": 120,
+        "step": 5
+      },
+      {
+        "type": "toggle",
+        "messageKey": "SweepSeconds",
+        "capabilities": ["NOT_PLATFORM_APLITE"],
+        "label": "Sweeping Second Hand",
+        "description": "Moves smoothly for the time above after launch or a wrist flick, then ticks",
+        "defaultValue": false
+      },
+      {
+        "type": "slider",
+        "messageKey": "SweepFps",
+        "capabilities": ["NOT_PLATFORM_APLITE"],
+        "defaultValue": 10,
+        "label": "Sweep Frames Per Second",
+        "min": 5,
+        "max": 15,
+        "step": 1
       }
     ]
   },
   {
     "type": "section",
+    "capabilities": ["COLOR"],
     "items": [
       {
         "type": "heading",
@@ -120,6 +155,13 @@ module.exports = [
         "defaultValue": true,
         "label": "Draw Clock Hour Markings"
       },
+      {
+        "type": "toggle",
+        "messageKey": "StepsComplication",
+        "capabilities": ["HEALTH"],
+        "defaultValue": false,
+        "label": "Show Steps Today"
+      },
       {
         "type": "toggle",
         "messageKey": "InvertOutline",
@@ -128,6 +170,59 @@ module.exports = [
       },
     ]
   },
+  {
+    "type": "section",
+    "items": [
+      {
+        "type": "heading",
+        "defaultValue": "Battery Saver"
+      },
+      {
+        "type": "slider",
+        "messageKey": "LowBatteryLevel",
+        "defaultValue": 20,
+        "label": "Stop Second Hand Below (%)",
+        "min": 0,
+        "max": 50,
+        "step": 5
+      },
+      {
+        "type": "slider",
+        "messageKey": "CriticalBatteryLevel",
+        "defaultValue": 10,
+        "label": "Simplify Watchface Below (%)",
+        "description": "Hides watchstrap details and hour markings. Full detail returns while charging",
+        "min": 0,
+        "max": 50,
+        "step": 5
+      },
+      {
+        "type": "toggle",
+        "messageKey": "NightMode",
+        "defaultValue": false,
+        "label": "Night Mode",
+        "description": "Simplified watchface without seconds while you sleep or during quiet hours"
+      },
+      {
+        "type": "slider",
+        "messageKey": "QuietStart",
+        "defaultValue": 23,
+        "label": "Quiet Hours Start",
+        "min": 0,
+        "max": 23,
+        "step": 1
+      },
+      {
+        "type": "slider",
+        "messageKey": "QuietEnd",
+        "defaultValue": 7,
+        "label": "Quiet Hours End",
+        "min": 0,
+        "max": 23,
+        "step": 1
+      }
+    ]
+  },
   {
     "type": "text",
     "defaultValue": "When you have finished your selection, hit SAVE!"
@@ -0,0 +1,101 @@
+// Order of the fields in the settings message, after the version byte.
+// Must match SETTINGS_MESSAGE_FIELDS in src/main.c, only ever append.
+var FIELDS = [
+  { key: 'SelectClock', type: 'char' },
+  { key: 'LeftStripeColor', type: 'color' },
+  { key: 'RightStripeColor', type: 'color' },
+  { key: 'WatchBandColor', type: 'color' },
+  { key: 'WatchFaceColor', type: 'color' },
+  { key: 'TextColor', type: 'color' },
+  { key: 'BatteryColor', type: 'color' },
+  { key: 'HandsColor', type: 'color' },
+  { key: 'SecondHandColor', type: 'color' },
+  { key: 'InvertOutline', type: 'bool' },
+  { key: 'BatteryBarToggle', type: 'bool' },
+  { key: 'StrapDetails', type: 'bool' },
+  { key: 'HourDots', type: 'bool' },
+  { key: 'AdaptiveSeconds', type: 'bool' },
+  { key: 'SecondsTimeout', type: 'byte' },
+  { key: 'LowBatteryLevel', type: 'byte' },
+  { key: 'CriticalBatteryLevel', type: 'byte' },
+  { key: 'NightMode', type: 'bool' },
+  { key: 'QuietStart', type: 'byte' },
+  { key: 'QuietEnd', type: 'byte' },
+  { key: 'SweepSeconds', type: 'bool' },
+  { key: 'SweepFps', type: 'byte' },
+  { key: 'StepsComplication', type: 'bool' }
+];
+
+// Version byte at the start of the message (SETTINGS_MESSAGE_VERSION)
+var VERSION = 1;
+
+// Platforms with a black and white display
+var BW_PLATFORMS = ['aplite', 'diorite'];
+
+// Default value of every messageKey in the Clay config
+function configDefaults(config, defaults) {
+  config.forEach(function(item) {
+    if (item.messageKey) {
+      defaults[item.messageKey] = item.defaultValue;
+    }
+    if (item.items) {
+      configDefaults(item.items, defaults);
+    }
+  });
+  return defaults;
+}
+
+// Convert a 0xRRGGBB color to a GColor8 byte (2 bits per channel, opaque)
+function toGColor8(value) {
+  if (typeof value === 'string') {
+    value = parseInt(value.replace('#', '').replace(/^0x/i, ''), 16);
+  }
+  return 0xC0 | ((value >> 22) & 0x3) << 4 | ((value >> 14) & 0x3) << 2 | ((value >> 6) & 0x3);
+}
+
+// Pack Clay settings (keyed by messageKey) into the settings message bytes
+// for the given watch platform
+function encode(values, config, platform) {
+  var defaults = configDefaults(config, {});
+  var bw = BW_PLATFORMS.indexOf(platform) !== -1;
+  var bytes = [VERSION];
+  FIELDS.forEach(function(field) {
+    var value = values[field.key];
+    // Sliders with a precision are stored as { value: ... }
+    if (value !== null && typeof value === 'object' && 'value' in value) {
+      value = value.value;
+    }
+    if (value === undefined || value === null) {
+      value = defaults[field.key];
+    }
+
+    if (field.type === 'color') {
+      // Black and white watches have no color settings, they show the defaults
+      bytes.push(toGColor8(bw ? defaults[field.key] : value));
+    } else if (field.type === 'bool') {
+      bytes.push(value ? 1 : 0);
+    } else if (field.type === 'char') {
+      bytes.push(String(value).charCodeAt(0));
+    } else {
+      bytes.push(Number(value) & 0xFF);
+    }
+  });
+  return bytes;
+}
+
+// 32-bit FNV-1a of the message bytes, same as settings_hash() in src/main.c
+function hash(bytes) {
+  var h = 0x811C9DC5;
+  bytes.forEach(function(b) {
+    h ^= b;
+    // h *= 16777619, without losing precision
+    h = (h + (h << 1) + (h << 4) + (h << 7) + (h << 8) + (h << 24)) >>> 0;
+  });
+  return h >>> 0;
+}
+
+module.exports = {
+  VERSION: VERSION,
+  encode: encode,
+  hash: hash
+};
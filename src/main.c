@@ -1,416 +1,1613 @@
 #include <pebble.h>
 #include "main.h"
+#include "render_stats.h"
 
 // Define window, layers, fonts, ints, etc
 static Window *s_window;
-static TextLayer *s_time_layer, *s_date_layer;
-static Layer *s_canvas_layer, *s_battery_layer, *s_hands_layer;
-static GFont s_time_font, s_date_font;
-static int s_battery_level;
+static TextLayer *s_date_layer;
+static Layer *s_canvas_layer, *s_battery_layer, *s_hands_layer, *s_second_layer;
+static GFont s_date_font;
+#if !defined(DIGIT_ATLAS)
+static TextLayer *s_time_layer;
+static GFont s_time_font;
+#endif
+static int s_battery_level = -1;
+static bool s_battery_charging;
+static PowerProfile s_power_profile = PowerProfileFull;
+// Asleep or inside the quiet hours
+static bool s_night_time;
+
+// Steps complication, never created on aplite
+static Layer *s_steps_layer;
+#if defined(PBL_HEALTH)
+static GFont s_steps_font;
+// Today's steps as last read (-1 before the first read or when unavailable),
+// their text and when they were read, and the pending rate-limited read
+static int32_t s_steps = -1;
+static char s_steps_text[sizeof("-2147483648 steps")];
+static time_t s_steps_read_time;
+static AppTimer *s_steps_timer;
+#endif
+
+#if defined(DIGIT_ATLAS)
+// Time drawn from a strip of pre-rendered digits instead of the time TextLayer
+static Layer *s_digits_layer;
+static GBitmap *s_atlas_bitmap;
+static GBitmap *s_atlas_cells[DIGIT_ATLAS_CELLS];
+#if !defined(PBL_PLATFORM_APLITE)
+// Palette entry of the atlas that holds the digit pixels
+static uint8_t s_atlas_ink;
+#endif
+// The time on screen, and where each of its characters goes
+static char s_digits[DIGIT_ATLAS_MAX_CHARS + 1];
+static GBitmap *s_digit_sprites[DIGIT_ATLAS_MAX_CHARS];
+static GRect s_digit_rects[DIGIT_ATLAS_MAX_CHARS];
+#endif
+
+// Launch work that can wait until the first frame is on screen
+static bool s_started;
+static AppTimer *s_startup_timer;
+
+// Background as a list of drawing ops, rebuilt after settings change
+static DrawList s_background_list;
+
+// Offscreen copy of the static background, rebuilt after settings change
+static GBitmap *s_background_bitmap;
+#if defined(PBL_COLOR)
+static GColor s_background_palette[MAX_BACKGROUND_COLORS];
+#endif
+
+// Adaptive second hand state: whether seconds are shown, and when they stop
+static bool s_seconds_active = true;
+static AppTimer *s_seconds_timer;
+// Currently subscribed tick rate
+static TimeUnits s_tick_unit;
+
+// Sweep second hand: its frame timer, when it stops, and the pacing state
+// (never set on aplite, where the compiler drops every sweeping branch)
+static bool s_sweeping;
+#if defined(SWEEP_SUPPORTED)
+static AppTimer *s_sweep_timer;
+static uint32_t s_sweep_end_ms;
+// Milliseconds into the minute the hand points at, only ever moves forward
+static uint16_t s_sweep_position;
+// When the last frame was requested, and how long it took to draw
+static uint32_t s_sweep_request_ms;
+static uint32_t s_sweep_frame_ms;
+static bool s_has_focus = true;
+#endif
+
+// Every face the watch can show, the first one is the default
+static const Face FACES[] = {
+  {
+    .clock = 'd',
+    .num_layers = 2,
+    .layers = {
+#if defined(DIGIT_ATLAS)
+      { .type = FaceLayerCanvas, .frame = &TIME_TEXT_RECT, .update_proc = digits_update_proc,
+        .layer = &s_digits_layer, .load = load_digit_atlas, .unload = unload_digit_atlas },
+#else
+      { .type = FaceLayerText, .frame = &TIME_TEXT_RECT, .text_layer = &s_time_layer,
+        .font_resource = RESOURCE_ID_NOTO_SANS_BOLD_36, .font = &s_time_font },
+#endif
+      { .type = FaceLayerText, .frame = &DATE_TEXT_RECT, .text_layer = &s_date_layer,
+        .font_resource = RESOURCE_ID_NOTO_SANS_REGULAR_18, .font = &s_date_font },
+    },
+  },
+  {
+    .clock = 'a',
+    .second_hand = true,
+    .hour_dots = true,
+    .num_layers = 2,
+    .layers = {
+      // Hour/minute hands and second hand are invalidated separately
+      { .type = FaceLayerCanvas, .update_proc = hands_update_proc, .layer = &s_hands_layer },
+      { .type = FaceLayerCanvas, .update_proc = second_update_proc, .layer = &s_second_layer },
+    },
+  },
+};
+// The face whose layers currently exist
+static const Face *s_face;
+
+// Everything derived from the time, updated once per tick (see tick_handler)
+static TimeState s_time;
+
+// Who depends on which time units, called in order after the time state is updated
+static const TickConsumer TICK_CONSUMERS[] = {
+  { HOUR_UNIT, update_night_mode },
+  { MINUTE_UNIT, show_time_text },
+  { DAY_UNIT, show_date_text },
+  { MINUTE_UNIT, redraw_hands },
+  { SECOND_UNIT, redraw_second_hand },
+};
 
-// Define constant paths for analog clock minute/hour hands
-static GPath *s_tick_paths[NUM_CLOCK_TICKS];
-static GPath *s_minute_arrow, *s_hour_arrow;
+// A struct for our specific settings (see main.h)
+ClaySettings settings;
+// The settings as last read from or written to flash
+static PersistedSettings s_persisted;
+
+#if defined(PBL_COLOR)
+#define COLOR_FIELD(name) { offsetof(ClaySettings, name), SettingsFieldColor }
+#else
+// No color settings to store, the phone always sends the default
+#define COLOR_FIELD(name) { DEFAULT_##name, SettingsFieldFixed }
+#endif
+
+// Layout of the settings message from the phone, after the version byte.
+// Must match FIELDS in src/js/settings.js, only ever append.
+static const SettingsField SETTINGS_MESSAGE_FIELDS[] = {
+  { offsetof(ClaySettings, SelectClock), SettingsFieldByte },
+  COLOR_FIELD(LeftStripeColor),
+  COLOR_FIELD(RightStripeColor),
+  COLOR_FIELD(WatchBandColor),
+  COLOR_FIELD(WatchFaceColor),
+  COLOR_FIELD(TextColor),
+  COLOR_FIELD(BatteryColor),
+  COLOR_FIELD(HandsColor),
+  COLOR_FIELD(SecondHandColor),
+  { offsetof(ClaySettings, InvertOutline), SettingsFieldBool },
+  { offsetof(ClaySettings, BatteryBarToggle), SettingsFieldBool },
+  { offsetof(ClaySettings, StrapDetails), SettingsFieldBool },
+  { offsetof(ClaySettings, HourDots), SettingsFieldBool },
+  { offsetof(ClaySettings, AdaptiveSeconds), SettingsFieldBool },
+  { offsetof(ClaySettings, SecondsTimeout), SettingsFieldByte },
+  { offsetof(ClaySettings, LowBatteryLevel), SettingsFieldByte },
+  { offsetof(ClaySettings, CriticalBatteryLevel), SettingsFieldByte },
+  { offsetof(ClaySettings, NightMode), SettingsFieldBool },
+  { offsetof(ClaySettings, QuietStart), SettingsFieldByte },
+  { offsetof(ClaySettings, QuietEnd), SettingsFieldByte },
+  { offsetof(ClaySettings, SweepSeconds), SettingsFieldBool },
+  { offsetof(ClaySettings, SweepFps), SettingsFieldByte },
+  { offsetof(ClaySettings, StepsComplication), SettingsFieldBool },
+};
+
+// Version byte plus one byte per field
+#define SETTINGS_MESSAGE_SIZE (1 + ARRAY_LENGTH(SETTINGS_MESSAGE_FIELDS))
+
+#if defined(RENDER_STATS) && !defined(SETTINGS_SOAK)
+// Simulated day in progress: its timer, the next second to run and how long
+// the flicked second hand has left
+static AppTimer *s_sim_timer;
+static int s_sim_second;
+static uint32_t s_sim_seconds_left;
+#endif
+
+#if defined(SETTINGS_SOAK)
+// Messages replayed so far, and the settings to return to afterwards
+static uint32_t s_soak_sent;
+static uint8_t s_soak_original[SETTINGS_MESSAGE_SIZE];
+#endif
+
+// Hash of the current settings message, shared with the phone on launch
+static uint32_t s_settings_hash;
+// Launch handshake retries while the phone's JS is still starting
+static int s_handshake_attempts;
+
+#if defined(PBL_COLOR)
+// Order of the colors in the packed settings, never reorder
+static const uint8_t SETTINGS_COLOR_OFFSETS[NUM_SETTINGS_COLORS] = {
+  offsetof(ClaySettings, LeftStripeColor),
+  offsetof(ClaySettings, RightStripeColor),
+  offsetof(ClaySettings, WatchBandColor),
+  offsetof(ClaySettings, WatchFaceColor),
+  offsetof(ClaySettings, TextColor),
+  offsetof(ClaySettings, BatteryColor),
+  offsetof(ClaySettings, HandsColor),
+  offsetof(ClaySettings, SecondHandColor),
+};
+#endif
+
+
+
+// Initialize the default settings
+static void default_settings() {
+  // Default settings
+#if defined(PBL_COLOR)
+  settings.LeftStripeColor = (GColor){ .argb = DEFAULT_LeftStripeColor };
+  settings.RightStripeColor = (GColor){ .argb = DEFAULT_RightStripeColor };
+  settings.WatchBandColor = (GColor){ .argb = DEFAULT_WatchBandColor };
+  settings.WatchFaceColor = (GColor){ .argb = DEFAULT_WatchFaceColor };
+  settings.TextColor = (GColor){ .argb = DEFAULT_TextColor };
+  settings.HandsColor = (GColor){ .argb = DEFAULT_HandsColor };
+  settings.SecondHandColor = (GColor){ .argb = DEFAULT_SecondHandColor };
+  settings.BatteryColor = (GColor){ .argb = DEFAULT_BatteryColor };
+#endif
+  settings.BatteryBarToggle = true;
+  settings.StrapDetails = true;
+  settings.InvertOutline = false;
+  settings.HourDots = true;
+  settings.SelectClock = 'd';
+  settings.AdaptiveSeconds = false;
+  settings.SecondsTimeout = 30;
+  settings.LowBatteryLevel = 20;
+  settings.CriticalBatteryLevel = 10;
+  settings.NightMode = false;
+  settings.QuietStart = 23;
+  settings.QuietEnd = 7;
+  settings.SweepSeconds = false;
+  settings.SweepFps = 10;
+  settings.StepsComplication = false;
+}
+
+
+
+#if defined(PBL_COLOR)
+// Color number index of the settings, in packed order
+static GColor *settings_color(int index) {
+  return (GColor *)((uint8_t *)&settings + SETTINGS_COLOR_OFFSETS[index]);
+}
+
+
+
+// Store the rgb bits of a color at position index of a 6-bit packed array
+static void pack_color(uint8_t *packed, int index, GColor color) {
+  int bit = index * 6;
+  // Line the 6 bits up inside a 16-bit window starting at the first byte
+  uint16_t window = (color.argb & 0x3F) << (10 - bit % 8);
+  packed[bit / 8] |= window >> 8;
+  if (window & 0xFF) {
+    packed[bit / 8 + 1] |= window & 0xFF;
+  }
+}
+
+
+
+// Read back a color packed by pack_color, always fully opaque
+static GColor unpack_color(const uint8_t *packed, int index) {
+  int bit = index * 6;
+  uint16_t window = packed[bit / 8] << 8;
+  if (bit % 8 > 2) {
+    window |= packed[bit / 8 + 1];
+  }
+  return (GColor){ .argb = 0xC0 | ((window >> (10 - bit % 8)) & 0x3F) };
+}
+#endif
+
+
+
+// Pack the current settings into their persisted form
+static void encode_settings(PersistedSettings *persisted) {
+  memset(persisted, 0, sizeof(*persisted));
+  persisted->version = SETTINGS_SCHEMA_VERSION;
+  persisted->clock = settings.SelectClock == 'a' ? ClockTypeAnalog : ClockTypeDigital;
+  persisted->flags = (settings.InvertOutline ? SettingsFlagInvertOutline : 0) |
+                     (settings.BatteryBarToggle ? SettingsFlagBatteryBar : 0) |
+                     (settings.StrapDetails ? SettingsFlagStrapDetails : 0) |
+                     (settings.HourDots ? SettingsFlagHourDots : 0) |
+                     (settings.AdaptiveSeconds ? SettingsFlagAdaptiveSeconds : 0) |
+                     (settings.NightMode ? SettingsFlagNightMode : 0) |
+                     (settings.SweepSeconds ? SettingsFlagSweepSeconds : 0) |
+                     (settings.StepsComplication ? SettingsFlagStepsComplication : 0);
+#if defined(PBL_COLOR)
+  for (int i = 0; i < NUM_SETTINGS_COLORS; ++i) {
+    pack_color(persisted->colors, i, *settings_color(i));
+  }
+#endif
+  persisted->seconds_timeout = settings.SecondsTimeout;
+  persisted->low_battery_level = settings.LowBatteryLevel;
+  persisted->critical_battery_level = settings.CriticalBatteryLevel;
+  persisted->quiet_start = settings.QuietStart;
+  persisted->quiet_end = settings.QuietEnd;
+  persisted->sweep_fps = settings.SweepFps;
+}
+
+
+
+// Unpack persisted settings, false if the record is not one we understand
+static bool decode_settings(const PersistedSettings *persisted, int size) {
+  // Newer schema (after a downgrade) or a truncated record, keep defaults
+  if (size != (int)sizeof(*persisted) || persisted->version != SETTINGS_SCHEMA_VERSION) {
+    return false;
+  }
+  settings.SelectClock = persisted->clock == ClockTypeAnalog ? 'a' : 'd';
+  settings.InvertOutline = persisted->flags & SettingsFlagInvertOutline;
+  settings.BatteryBarToggle = persisted->flags & SettingsFlagBatteryBar;
+  settings.StrapDetails = persisted->flags & SettingsFlagStrapDetails;
+  settings.HourDots = persisted->flags & SettingsFlagHourDots;
+  settings.AdaptiveSeconds = persisted->flags & SettingsFlagAdaptiveSeconds;
+  settings.NightMode = persisted->flags & SettingsFlagNightMode;
+  settings.SweepSeconds = persisted->flags & SettingsFlagSweepSeconds;
+  settings.StepsComplication = persisted->flags & SettingsFlagStepsComplication;
+#if defined(PBL_COLOR)
+  for (int i = 0; i < NUM_SETTINGS_COLORS; ++i) {
+    *settings_color(i) = unpack_color(persisted->colors, i);
+  }
+#endif
+  settings.SecondsTimeout = persisted->seconds_timeout;
+  settings.LowBatteryLevel = persisted->low_battery_level;
+  settings.CriticalBatteryLevel = persisted->critical_battery_level;
+  settings.QuietStart = persisted->quiet_start;
+  settings.QuietEnd = persisted->quiet_end;
+  settings.SweepFps = persisted->sweep_fps;
+  return true;
+}
+
+
+
+// Convert the raw struct saved by 1.0, then drop it
+static bool migrate_legacy_settings() {
+  LegacySettings legacy;
+  // Anything but a whole 1.0 record keeps the defaults
+  if (persist_get_size(SETTINGS_KEY) != (int)sizeof(legacy) ||
+      persist_read_data(SETTINGS_KEY, &legacy, sizeof(legacy)) != (int)sizeof(legacy)) {
+    return false;
+  }
+  settings.SelectClock = legacy.SelectClock;
+#if defined(PBL_COLOR)
+  settings.LeftStripeColor = legacy.LeftStripeColor;
+  settings.RightStripeColor = legacy.RightStripeColor;
+  settings.WatchBandColor = legacy.WatchBandColor;
+  settings.WatchFaceColor = legacy.WatchFaceColor;
+  settings.TextColor = legacy.TextColor;
+  settings.BatteryColor = legacy.BatteryColor;
+  settings.HandsColor = legacy.HandsColor;
+  settings.SecondHandColor = legacy.SecondHandColor;
+#endif
+  settings.InvertOutline = legacy.InvertOutline;
+  settings.BatteryBarToggle = legacy.BatteryBarToggle;
+  settings.StrapDetails = legacy.StrapDetails;
+  settings.HourDots = legacy.HourDots;
+  return true;
+}
+
+
+
+// Read settings from persistent storage
+static void load_settings() {
+  // Load the default settings
+  default_settings();
+
+  // Read settings from persistent storage, if they exist
+  if (persist_exists(SETTINGS_BLOB_KEY)) {
+    int size = persist_read_data(SETTINGS_BLOB_KEY, &s_persisted, sizeof(s_persisted));
+    if (!decode_settings(&s_persisted, size)) {
+      default_settings();
+    }
+  } else if (persist_exists(SETTINGS_KEY)) {
+    // Rewrite the old raw struct in the versioned format once
+    if (migrate_legacy_settings()) {
+      save_settings();
+    }
+    persist_delete(SETTINGS_KEY);
+  }
+}
+
+
+
+// Save the settings to persistent storage
+static void save_settings() {
+  PersistedSettings persisted;
+  encode_settings(&persisted);
+  // Only touch flash when the encoded settings actually changed
+  if (memcmp(&persisted, &s_persisted, sizeof(persisted)) == 0) {
+    return;
+  }
+  // Make settings persist
+  if (persist_write_data(SETTINGS_BLOB_KEY, &persisted, sizeof(persisted)) == (int)sizeof(persisted)) {
+    s_persisted = persisted;
+  }
+}
+
+
+
+// Apply new settings to the existing window, rebuilding only what changed
+static void apply_settings(const ClaySettings *previous) {
+  Layer *window_layer = window_get_root_layer(s_window);
+
+  // Swap the digital/analog layer set when the clock type changes
+  if (settings.SelectClock != previous->SelectClock) {
+    destroy_face_layers();
+    create_face_layers(window_layer);
+  }
+
+  // Pick the second hand mode and tick rate for the clock type
+  if (settings.SelectClock != previous->SelectClock ||
+      settings.AdaptiveSeconds != previous->AdaptiveSeconds ||
+      settings.SecondsTimeout != previous->SecondsTimeout ||
+      settings.SweepSeconds != previous->SweepSeconds ||
+      settings.SweepFps != previous->SweepFps) {
+    configure_seconds_mode();
+  }
+
+  // Add or remove the battery meter
+  if (settings.BatteryBarToggle != previous->BatteryBarToggle) {
+    if (settings.BatteryBarToggle) {
+      create_battery_layer();
+    } else {
+      destroy_battery_layer();
+    }
+  } else if (s_battery_layer && SETTINGS_COLOR_CHANGED(previous, BatteryColor)) {
+    layer_mark_dirty(s_battery_layer);
+  }
+
+  // Add or remove the steps complication
+  if (settings.StepsComplication != previous->StepsComplication) {
+    if (settings.StepsComplication) {
+      create_steps_layer();
+    } else {
+      destroy_steps_layer();
+    }
+  } else if (s_steps_layer && SETTINGS_COLOR_CHANGED(previous, TextColor)) {
+    layer_mark_dirty(s_steps_layer);
+  }
+
+  // Night mode or battery thresholds may move us to another power profile
+  if (settings.NightMode != previous->NightMode ||
+      settings.QuietStart != previous->QuietStart ||
+      settings.QuietEnd != previous->QuietEnd) {
+    time_t temp = time(NULL);
+    update_night_mode(localtime(&temp));
+  } else if (settings.LowBatteryLevel != previous->LowBatteryLevel ||
+             settings.CriticalBatteryLevel != previous->CriticalBatteryLevel) {
+    update_power_profile();
+  }
+
+  // Stripes, circle, strap details and hour dots all live in the cached background
+  if (settings.SelectClock != previous->SelectClock ||
+      settings.StrapDetails != previous->StrapDetails ||
+      settings.HourDots != previous->HourDots ||
+      settings.InvertOutline != previous->InvertOutline ||
+      SETTINGS_COLOR_CHANGED(previous, LeftStripeColor) ||
+      SETTINGS_COLOR_CHANGED(previous, RightStripeColor) ||
+      SETTINGS_COLOR_CHANGED(previous, WatchBandColor) ||
+      SETTINGS_COLOR_CHANGED(previous, WatchFaceColor)) {
+    invalidate_background();
+  }
+
+  // Color-only changes on the face layers just need a redraw
+  if (s_face && SETTINGS_COLOR_CHANGED(previous, TextColor)) {
+    for (int i = 0; i < s_face->num_layers; ++i) {
+      if (s_face->layers[i].type == FaceLayerText) {
+        text_layer_set_text_color(*s_face->layers[i].text_layer, SETTINGS_COLOR(TextColor));
+      }
+    }
+#if defined(DIGIT_ATLAS)
+    if (s_digits_layer) {
+      recolor_digits();
+      layer_mark_dirty(s_digits_layer);
+    }
+#endif
+  }
+  if (s_hands_layer && SETTINGS_COLOR_CHANGED(previous, HandsColor)) {
+    layer_mark_dirty(s_hands_layer);
+  }
+  if (s_second_layer && SETTINGS_COLOR_CHANGED(previous, SecondHandColor)) {
+    layer_mark_dirty(s_second_layer);
+  }
+}
+
+
+
+// Unpack a settings message, false if it is not in a format we understand
+static bool decode_settings_message(const uint8_t *data, uint16_t length) {
+  if (length < 1 || data[0] != SETTINGS_MESSAGE_VERSION) {
+    return false;
+  }
+
+  // One pass through the descriptor table, each field is a single byte
+  uint16_t count = length - 1;
+  if (count > ARRAY_LENGTH(SETTINGS_MESSAGE_FIELDS)) {
+    count = ARRAY_LENGTH(SETTINGS_MESSAGE_FIELDS);
+  }
+  uint8_t *base = (uint8_t *)&settings;
+  for (uint16_t i = 0; i < count; ++i) {
+    uint8_t value = data[1 + i];
+    const SettingsField *field = &SETTINGS_MESSAGE_FIELDS[i];
+    switch (field->type) {
+#if defined(PBL_COLOR)
+      case SettingsFieldColor:
+        // Already a GColor8 from the phone, just make sure it is opaque
+        base[field->offset] = value | 0xC0;
+        break;
+#else
+      case SettingsFieldFixed:
+        break;
+#endif
+      case SettingsFieldBool:
+        base[field->offset] = value != 0;
+        break;
+      case SettingsFieldByte:
+        base[field->offset] = value;
+        break;
+    }
+  }
+  return true;
+}
+
+
+
+// Pack the current settings exactly the way the phone would send them
+static void encode_settings_message(uint8_t *data) {
+  const uint8_t *base = (const uint8_t *)&settings;
+  data[0] = SETTINGS_MESSAGE_VERSION;
+  for (size_t i = 0; i < ARRAY_LENGTH(SETTINGS_MESSAGE_FIELDS); ++i) {
+    const SettingsField *field = &SETTINGS_MESSAGE_FIELDS[i];
+#if defined(PBL_BW)
+    if (field->type == SettingsFieldFixed) {
+      data[1 + i] = field->offset;
+      continue;
+    }
+#endif
+    data[1 + i] = base[field->offset];
+  }
+}
+
+
+
+// 32-bit FNV-1a, also implemented in src/js/settings.js
+static uint32_t settings_hash(const uint8_t *data, uint16_t length) {
+  uint32_t hash = 2166136261u;
+  for (uint16_t i = 0; i < length; ++i) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+
+
+// Recompute the hash of the current settings
+static void update_settings_hash() {
+  uint8_t data[SETTINGS_MESSAGE_SIZE];
+  encode_settings_message(data);
+  s_settings_hash = settings_hash(data, sizeof(data));
+}
+
+
+
+// Tell the phone which settings we have, it only resends them on mismatch
+static void send_settings_hash() {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return;
+  }
+  dict_write_uint32(iter, MESSAGE_KEY_SettingsHash, s_settings_hash);
+  dict_write_uint8(iter, MESSAGE_KEY_SettingsVersion, SETTINGS_MESSAGE_VERSION);
+  app_message_outbox_send();
+}
+
+
+
+// Retry the handshake a few times while the phone's JS starts up
+static void handshake_retry_callback(void *data) {
+  send_settings_hash();
+}
+
+
+
+// The handshake did not get through
+static void outbox_failed_handler(DictionaryIterator *iter, AppMessageResult reason, void *context) {
+  if (++s_handshake_attempts < HANDSHAKE_MAX_ATTEMPTS) {
+    app_timer_register(HANDSHAKE_RETRY_MS, handshake_retry_callback, NULL);
+  }
+}
+
+
+
+// Handle the response from AppMessage
+static void inbox_received_handler(DictionaryIterator *iter, void *context) {
+  // The phone sends every setting in one packed byte array
+  Tuple *blob_t = dict_find(iter, MESSAGE_KEY_SettingsBlob);
+  if (!blob_t) {
+    return;
+  }
+
+  // Repeated identical messages are only applied once
+  if (settings_hash(blob_t->value->data, blob_t->length) == s_settings_hash) {
+    return;
+  }
+
+  // Remember the current settings so only the differences are applied
+  ClaySettings previous = settings;
+  if (!decode_settings_message(blob_t->value->data, blob_t->length)) {
+    return;
+  }
+  update_settings_hash();
+
+  // Save the new settings to persistent storage
+  save_settings();
+  // Update the display based on new settings
+  apply_settings(&previous);
+  RENDER_STATS_HEAP("apply");
+#if defined(RENDER_STATS) && !defined(SETTINGS_SOAK)
+  // Report the simulated day of the new configuration
+  start_simulation();
+#endif
+}
+
+
+
+// Recompute the parts of the time state that depend on the changed units
+static void update_time_state(struct tm *t, TimeUnits units_changed) {
+  s_time.second_step = t->tm_sec;
+  // The tick service sets MINUTE_UNIT whenever the hour or day changes too
+  if (units_changed & MINUTE_UNIT) {
+    s_time.hour_step = (t->tm_hour % 12) * 60 + t->tm_min;
+    s_time.minute_step = t->tm_min;
+    // Write the current hours and minutes into a buffer
+    // (the time and date fonts only carry the glyphs these formats produce)
+    strftime(s_time.time_text, sizeof(s_time.time_text), clock_is_24h_style() ?
+                                                          "%H:%M" : "%I:%M", t);
+  }
+  if (units_changed & DAY_UNIT) {
+    strftime(s_time.date_text, sizeof(s_time.date_text), "%b %d", t);
+  }
+}
+
+
+
+// The one tick handler: update the time state, then notify whoever depends on it
+static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+  update_time_state(tick_time, units_changed);
+  for (size_t i = 0; i < ARRAY_LENGTH(TICK_CONSUMERS); ++i) {
+    if (units_changed & TICK_CONSUMERS[i].units) {
+      TICK_CONSUMERS[i].update(tick_time);
+    }
+  }
+}
+
+
+
+// Bring the face up to date with the current time outside of a tick
+static void refresh_time(TimeUnits units) {
+  time_t temp = time(NULL);
+  tick_handler(localtime(&temp), units);
+}
+
+
+
+// Display the time on the TextLayer
+static void show_time_text(struct tm *t) {
+#if defined(DIGIT_ATLAS)
+  if (s_digits_layer) {
+    set_digits(s_time.time_text);
+  }
+#else
+  if (s_time_layer) {
+    text_layer_set_text(s_time_layer, s_time.time_text);
+  }
+#endif
+}
+
+
+
+// Show the date on the TextLayer
+static void show_date_text(struct tm *t) {
+  if (s_date_layer) {
+    text_layer_set_text(s_date_layer, s_time.date_text);
+  }
+}
+
+
+
+// Hour/minute hands only move once a minute
+static void redraw_hands(struct tm *t) {
+  if (s_hands_layer) {
+    layer_mark_dirty(s_hands_layer);
+  }
+}
+
+
+
+// Only redraw the second hand while it is shown
+static void redraw_second_hand(struct tm *t) {
+  if (s_second_layer && seconds_shown() && !s_sweeping) {
+    layer_mark_dirty(s_second_layer);
+  }
+}
+
+
+
+// Record Battery Level
+static void battery_callback(BatteryChargeState state) {
+  // Record the new battery level, redrawing the meter only when it changes
+  if (state.charge_percent != s_battery_level) {
+    s_battery_level = state.charge_percent;
+    if (s_battery_layer) {
+      layer_mark_dirty(s_battery_layer);
+    }
+  }
+  s_battery_charging = state.is_charging || state.is_plugged;
+  update_power_profile();
+}
+
+
+
+// Pick the power profile for the current battery state
+static PowerProfile battery_power_profile() {
+  if (s_battery_charging) {
+    return PowerProfileFull;
+  } else if (s_battery_level < settings.CriticalBatteryLevel) {
+    return PowerProfileMinimal;
+  } else if (s_battery_level < settings.LowBatteryLevel) {
+    return PowerProfileSaver;
+  }
+  return PowerProfileFull;
+}
+
+
+
+// Switch power profile, updating the face and tick rate if it changed
+static void update_power_profile() {
+  // Night time always gets the minimal face, even while charging
+  PowerProfile profile = s_night_time ? PowerProfileMinimal : battery_power_profile();
+  if (profile == s_power_profile) {
+    return;
+  }
+  PowerProfile previous = s_power_profile;
+  s_power_profile = profile;
+
+  // Strap details and hour dots come and go with the minimal profile
+  if ((previous == PowerProfileMinimal) != (profile == PowerProfileMinimal)) {
+    invalidate_background();
+  }
+  subscribe_tick_timer();
+}
+
+
+
+// Whether the wearer is asleep or it is within the quiet hours
+static bool night_time(struct tm *t) {
+  if (!settings.NightMode) {
+    return false;
+  }
+#if defined(PBL_HEALTH)
+  // Trust the sleep tracker when it is available
+  HealthActivityMask activities = health_service_peek_current_activities();
+  if (activities & (HealthActivitySleep | HealthActivityRestfulSleep)) {
+    return true;
+  }
+#endif
+  // Quiet hours may wrap around midnight (e.g. 23 to 7)
+  if (settings.QuietStart <= settings.QuietEnd) {
+    return t->tm_hour >= settings.QuietStart && t->tm_hour < settings.QuietEnd;
+  }
+  return t->tm_hour >= settings.QuietStart || t->tm_hour < settings.QuietEnd;
+}
+
+
+
+// Re-evaluate night mode and switch power profile if needed
+static void update_night_mode(struct tm *t) {
+  s_night_time = night_time(t);
+  update_power_profile();
+}
+
+
+
+#if defined(PBL_HEALTH)
+// Sleep state changed, or there are new steps to show
+static void health_handler(HealthEventType event, void *context) {
+  if (event == HealthEventSleepUpdate || event == HealthEventSignificantUpdate) {
+    time_t temp = time(NULL);
+    update_night_mode(localtime(&temp));
+  }
+  // Only read the steps while they are shown
+  if (s_steps_layer) {
+    if (event == HealthEventSignificantUpdate) {
+      // All health data may have changed, a new day for one
+      refresh_steps();
+    } else if (event == HealthEventMovementUpdate) {
+      schedule_steps_refresh();
+    }
+  }
+}
+#endif
+
+
+
+// Whether the analog second hand is drawn right now
+static bool seconds_shown() {
+  return s_seconds_active && s_power_profile == PowerProfileFull;
+}
+
+
+
+// Draw battery meter
+static void battery_update_proc(Layer *layer, GContext *ctx) {
+  RENDER_STATS_BEGIN(RenderProcBattery, layer);
+  // Nothing to draw until the first battery reading
+  if (s_battery_level >= 0) {
+    // Find bounds
+    GRect bounds = layer_get_bounds(layer);
+    // Look up the end angle of the battery arc
+    int32_t angle_end = BATTERY_ARC_ANGLES[s_battery_level > 100 ? 100 : s_battery_level];
+    
+    // Draw the battery arc
+    graphics_context_set_stroke_color(ctx, SETTINGS_COLOR(BatteryColor));
+    graphics_context_set_stroke_width(ctx, 5);
+    graphics_draw_arc(ctx, bounds, GOvalScaleModeFitCircle, 0, angle_end);
+  }
+  RENDER_STATS_END(RenderProcBattery);
+}
+
+
+
+// Append one drawing op to the background display list
+static void emit_op(DrawOpType type, uint8_t value, GPoint a, GPoint b) {
+  if (s_background_list.count < MAX_BACKGROUND_OPS) {
+    s_background_list.ops[s_background_list.count++] = (DrawOp) {
+      .type = type, .value = value, .a = a, .b = b,
+    };
+  }
+}
+
+
+
+// Append a context state change, unless the context is already in that state
+static void emit_state(DrawOpType type, uint8_t value) {
+  if (s_background_list.state_known[type] && s_background_list.state[type] == value) {
+    return;
+  }
+  s_background_list.state_known[type] = true;
+  s_background_list.state[type] = value;
+  emit_op(type, value, GPointZero, GPointZero);
+}
+
+
+
+// Turn the settings into the ops that draw the background (stripes, circle,
+// strap and hour dots), all positions come from the generated geometry.h
+static void build_background_list() {
+  memset(&s_background_list, 0, sizeof(s_background_list));
+  // The minimal power profile draws a simplified face
+  bool strap_details = settings.StrapDetails && s_power_profile != PowerProfileMinimal;
+  bool hour_dots = settings.HourDots && s_power_profile != PowerProfileMinimal &&
+                   s_face && s_face->hour_dots;
+  uint8_t outline = settings.InvertOutline ? GColorWhite.argb : GColorBlack.argb;
+  GPoint center = GPoint(FACE_CENTER_X, FACE_CENTER_Y);
+
+  // Three stripes, a rect is stored as origin and size
+  const GRect *stripes[] = { &LEFT_STRIPE_RECT, &MIDDLE_STRIPE_RECT, &RIGHT_STRIPE_RECT };
+  const GColor colors[] = { SETTINGS_COLOR(LeftStripeColor), SETTINGS_COLOR(WatchBandColor),
+                            SETTINGS_COLOR(RightStripeColor) };
+  for (size_t i = 0; i < ARRAY_LENGTH(stripes); ++i) {
+    emit_state(DrawOpFillColor, colors[i].argb);
+    emit_op(DrawOpFillRect, 0, stripes[i]->origin, GPoint(stripes[i]->size.w, stripes[i]->size.h));
+  }
+
+  // Two lines along the band
+  emit_state(DrawOpStrokeColor, outline);
+  if (strap_details) {
+    int16_t bottom = MIDDLE_STRIPE_RECT.size.h;
+    emit_state(DrawOpStrokeWidth, 3);
+    emit_op(DrawOpDrawLine, 0, GPoint(STRIPE_LEFT_X, 0), GPoint(STRIPE_LEFT_X, bottom));
+    emit_op(DrawOpDrawLine, 0, GPoint(STRIPE_RIGHT_X, 0), GPoint(STRIPE_RIGHT_X, bottom));
+  }
+
+  // The face circle (the stroke width must be an odd integer value)
+  emit_state(DrawOpStrokeWidth, FACE_OUTLINE_WIDTH);
+  emit_op(DrawOpDrawCircle, FACE_RADIUS, center, GPointZero);
+  emit_state(DrawOpFillColor, SETTINGS_COLOR(WatchFaceColor).argb);
+  emit_op(DrawOpFillCircle, FACE_RADIUS, center, GPointZero);
+
+  // Strap dots don't overlap, so all outlines go before all fills
+  if (strap_details) {
+    for (size_t i = 0; i < ARRAY_LENGTH(STRAP_DOT_CENTERS); ++i) {
+      emit_op(DrawOpDrawCircle, DOT_RADIUS, STRAP_DOT_CENTERS[i], GPointZero);
+    }
+    emit_state(DrawOpFillColor, SETTINGS_COLOR(WatchBandColor).argb);
+    for (size_t i = 0; i < ARRAY_LENGTH(STRAP_DOT_CENTERS); ++i) {
+      emit_op(DrawOpFillCircle, DOT_RADIUS, STRAP_DOT_CENTERS[i], GPointZero);
+    }
+  }
+
+  // Hour placements for the analog clock
+  if (hour_dots) {
+    emit_state(DrawOpFillColor, outline);
+    for (size_t i = 0; i < ARRAY_LENGTH(HOUR_DOT_CENTERS); ++i) {
+      emit_op(DrawOpFillCircle, DOT_RADIUS, HOUR_DOT_CENTERS[i], GPointZero);
+    }
+  }
+  s_background_list.valid = true;
+}
+
+
+
+// Replay the background display list, building it first after a settings change
+static void draw_background(GContext *ctx) {
+  if (!s_background_list.valid) {
+    build_background_list();
+  }
+  for (int i = 0; i < s_background_list.count; ++i) {
+    const DrawOp *op = &s_background_list.ops[i];
+    switch (op->type) {
+      case DrawOpFillColor:
+        graphics_context_set_fill_color(ctx, (GColor) { .argb = op->value });
+        break;
+      case DrawOpStrokeColor:
+        graphics_context_set_stroke_color(ctx, (GColor) { .argb = op->value });
+        break;
+      case DrawOpStrokeWidth:
+        graphics_context_set_stroke_width(ctx, op->value);
+        break;
+      case DrawOpFillRect:
+        graphics_fill_rect(ctx, GRect(op->a.x, op->a.y, op->b.x, op->b.y), 0, GCornersAll);
+        break;
+      case DrawOpDrawLine:
+        graphics_draw_line(ctx, op->a, op->b);
+        break;
+      case DrawOpDrawCircle:
+        graphics_draw_circle(ctx, op->a, op->value);
+        break;
+      case DrawOpFillCircle:
+        graphics_fill_circle(ctx, op->a, op->value);
+        break;
+    }
+  }
+}
+
+
+
+// Forget the cached background so the next frame redraws the vectors
+static void invalidate_background() {
+  s_background_list.valid = false;
+  if (s_background_bitmap) {
+    gbitmap_destroy(s_background_bitmap);
+    s_background_bitmap = NULL;
+  }
+  if (s_canvas_layer) {
+    layer_mark_dirty(s_canvas_layer);
+  }
+}
+
+
+
+// Copy the freshly drawn background out of the framebuffer
+static void cache_background(GContext *ctx, GRect bounds) {
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if (!frame_buffer) {
+    return;
+  }
+
+#if defined(PBL_COLOR)
+  // Build a palette of the colors actually used, mapping each to an index
+  uint8_t index_of[256];
+  memset(index_of, 0xFF, sizeof(index_of));
+  int num_colors = 0;
+  for (int y = 0; y < bounds.size.h && num_colors <= MAX_BACKGROUND_COLORS; ++y) {
+    GBitmapDataRowInfo row = gbitmap_get_data_row_info(frame_buffer, y);
+    for (int x = row.min_x; x <= row.max_x; ++x) {
+      uint8_t argb = row.data[x];
+      if (index_of[argb] != 0xFF) {
+        continue;
+      }
+      if (num_colors == MAX_BACKGROUND_COLORS) {
+        // Too many colors (antialiasing), fall back to an 8-bit copy
+        num_colors++;
+        break;
+      }
+      s_background_palette[num_colors] = (GColor){ .argb = argb };
+      index_of[argb] = num_colors++;
+    }
+  }
+
+  // Pick the smallest palettized format that holds every color
+  uint8_t bits_per_pixel;
+  GBitmapFormat format;
+  if (num_colors <= 2) {
+    bits_per_pixel = 1;
+    format = GBitmapFormat1BitPalette;
+  } else if (num_colors <= 4) {
+    bits_per_pixel = 2;
+    format = GBitmapFormat2BitPalette;
+  } else if (num_colors <= MAX_BACKGROUND_COLORS) {
+    bits_per_pixel = 4;
+    format = GBitmapFormat4BitPalette;
+  } else {
+    bits_per_pixel = 8;
+    format = GBitmapFormat8Bit;
+  }
+
+  if (bits_per_pixel == 8) {
+    s_background_bitmap = gbitmap_create_blank(bounds.size, format);
+  } else {
+    s_background_bitmap = gbitmap_create_blank_with_palette(bounds.size, format,
+                                                            s_background_palette, false);
+  }
+
+  if (s_background_bitmap) {
+    uint8_t *data = gbitmap_get_data(s_background_bitmap);
+    uint16_t stride = gbitmap_get_bytes_per_row(s_background_bitmap);
+    uint8_t pixels_per_byte = 8 / bits_per_pixel;
+    for (int y = 0; y < bounds.size.h; ++y) {
+      GBitmapDataRowInfo row = gbitmap_get_data_row_info(frame_buffer, y);
+      uint8_t *dest = data + y * stride;
+      for (int x = row.min_x; x <= row.max_x; ++x) {
+        if (bits_per_pixel == 8) {
+          dest[x] = row.data[x];
+        } else {
+          // Palettized pixels are packed most significant bits first
+          uint8_t shift = 8 - bits_per_pixel * (x % pixels_per_byte + 1);
+          dest[x / pixels_per_byte] |= index_of[row.data[x]] << shift;
+        }
+      }
+    }
+  }
+#else
+  // Aplite's framebuffer is already 1-bit, so copy it row by row
+  s_background_bitmap = gbitmap_create_blank(bounds.size, GBitmapFormat1Bit);
+  if (s_background_bitmap) {
+    uint8_t *src = gbitmap_get_data(frame_buffer);
+    uint8_t *dest = gbitmap_get_data(s_background_bitmap);
+    uint16_t src_stride = gbitmap_get_bytes_per_row(frame_buffer);
+    uint16_t dest_stride = gbitmap_get_bytes_per_row(s_background_bitmap);
+    uint16_t row_bytes = src_stride < dest_stride ? src_stride : dest_stride;
+    for (int y = 0; y < bounds.size.h; ++y) {
+      memcpy(dest + y * dest_stride, src + y * src_stride, row_bytes);
+    }
+  }
+#endif
+
+  graphics_release_frame_buffer(ctx, frame_buffer);
+}
+
+
+
+// Draw background
+static void canvas_update_proc(Layer *layer, GContext *ctx) {
+  RENDER_STATS_BEGIN(RenderProcCanvas, layer);
+  GRect bounds = layer_get_bounds(layer);
+
+  if (s_background_bitmap) {
+    // Blit the cached background if it is still valid
+    graphics_draw_bitmap_in_rect(ctx, s_background_bitmap, bounds);
+  } else {
+    // Otherwise draw the vectors once and keep a copy for the next frames,
+    // the launch frame skips the copy so it reaches the screen sooner
+    draw_background(ctx);
+    if (s_started) {
+      cache_background(ctx, bounds);
+    }
+  }
+  // A timer fires once this frame has been pushed to the display
+  if (!s_started && !s_startup_timer) {
+    s_startup_timer = app_timer_register(0, finish_startup, NULL);
+  }
+  RENDER_STATS_END(RenderProcCanvas);
+}
+
+
+
+// Offset a point on the face from the center
+static GPoint hand_point(GPoint center, HandOffset offset) {
+  return GPoint(center.x + offset.x, center.y + offset.y);
+}
+
+
+
+// Draw analog watchface hour/minute hands layer
+static void hands_update_proc(Layer *layer, GContext *ctx) {
+  RENDER_STATS_BEGIN(RenderProcHands, layer);
+  GPoint center = GPoint(FACE_CENTER_X, FACE_CENTER_Y);
+
+  // minute/hour hand, positions come from the last minute tick
+  graphics_context_set_stroke_color(ctx, SETTINGS_COLOR(HandsColor));
+  graphics_context_set_stroke_width(ctx, 5);
+  graphics_draw_line(ctx, center, hand_point(center, HOUR_HAND_OFFSETS[s_time.hour_step]));
+  graphics_draw_line(ctx, center, hand_point(center, MINUTE_HAND_OFFSETS[s_time.minute_step]));
+  RENDER_STATS_END(RenderProcHands);
+}
+
+
+
+// Draw analog watchface second hand layer
+static void second_update_proc(Layer *layer, GContext *ctx) {
+  RENDER_STATS_BEGIN(RenderProcSecond, layer);
+  GPoint center = GPoint(FACE_CENTER_X, FACE_CENTER_Y);
+
+  // second hand, from the table on ticks or at any angle while sweeping
+  GPoint tip;
+#if defined(SWEEP_SUPPORTED)
+  if (s_sweeping) {
+    // Scaled down first so the product fits an int32_t for the whole minute
+    int32_t angle = s_sweep_position * (TRIG_MAX_ANGLE / 4) / 15000;
+    tip = GPoint(center.x + sin_lookup(angle) * SECOND_HAND_LENGTH / TRIG_MAX_RATIO,
+                 center.y - cos_lookup(angle) * SECOND_HAND_LENGTH / TRIG_MAX_RATIO);
+  } else
+#endif
+  {
+    tip = hand_point(center, SECOND_HAND_OFFSETS[s_time.second_step]);
+  }
+  graphics_context_set_stroke_color(ctx, SETTINGS_COLOR(SecondHandColor));
+  graphics_context_set_stroke_width(ctx, 3);
+  graphics_draw_line(ctx, tip, center);
+
+  // dot in the middle
+  graphics_context_set_fill_color(ctx, SETTINGS_COLOR(SecondHandColor));
+  graphics_fill_circle(ctx, center, 3);
+  RENDER_STATS_END(RenderProcSecond);
+
+#if defined(SWEEP_SUPPORTED)
+  // The second hand is the top face layer, so the frame is nearly done
+  if (s_sweeping) {
+    s_sweep_frame_ms = milliseconds_now() - s_sweep_request_ms;
+  }
+#endif
+}
+
+
+
+// Idle period is over, hide the second hand and drop to minute ticks
+static void seconds_timeout_callback(void *data) {
+  s_seconds_timer = NULL;
+  s_seconds_active = false;
+  stop_sweep();
+  subscribe_tick_timer();
+}
+
+
+
+// Show the second hand and tick every second for the configured period
+static void start_seconds_burst() {
+  s_seconds_active = true;
+  uint32_t timeout_ms = settings.SecondsTimeout * 1000;
+  if (!s_seconds_timer || !app_timer_reschedule(s_seconds_timer, timeout_ms)) {
+    s_seconds_timer = app_timer_register(timeout_ms, seconds_timeout_callback, NULL);
+  }
+  subscribe_tick_timer();
+}
+
+
+
+// Wrist flick wakes the second hand
+static void accel_tap_handler(AccelAxisType axis, int32_t direction) {
+  if (settings.AdaptiveSeconds) {
+    start_seconds_burst();
+  }
+  start_sweep();
+}
+
+
+
+// Choose between an always-on and a tap-activated second hand
+static void configure_seconds_mode() {
+  // Restart the sweep below with the new settings
+  stop_sweep();
+  bool second_hand = s_face && s_face->second_hand;
+  if (second_hand && settings.AdaptiveSeconds) {
+    accel_tap_service_subscribe(accel_tap_handler);
+    // Show seconds right away, they hide again after the timeout
+    start_seconds_burst();
+  } else {
+    // A flick restarts the sweep after it timed out
+    if (second_hand && settings.SweepSeconds) {
+      accel_tap_service_subscribe(accel_tap_handler);
+    } else {
+      accel_tap_service_unsubscribe();
+    }
+    if (s_seconds_timer) {
+      app_timer_cancel(s_seconds_timer);
+      s_seconds_timer = NULL;
+    }
+    s_seconds_active = true;
+    subscribe_tick_timer();
+  }
+  start_sweep();
+}
 
-// A struct for our specific settings (see main.h)
-ClaySettings settings;
 
 
+#if defined(SWEEP_SUPPORTED)
+// Milliseconds since the epoch, wrapping is fine for short differences
+static uint32_t milliseconds_now() {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return (uint32_t)seconds * 1000 + millis;
+}
 
-// Initialize the default settings
-static void default_settings() {
-  // Default settings
-  settings.LeftStripeColor = GColorDarkGray;
-  settings.RightStripeColor = GColorDarkGray;
-  settings.WatchBandColor = GColorWhite;
-  settings.WatchFaceColor = GColorWhite;
-  settings.TextColor = GColorBlack;
-  settings.HandsColor = GColorBlack;
-  settings.SecondHandColor = GColorLightGray;
-  settings.BatteryColor = GColorLightGray;
-  settings.BatteryBarToggle = true;
-  settings.StrapDetails = true;
-  settings.InvertOutline = false;
-  settings.HourDots = true;
-  settings.SelectClock = 'd';
+
+
+// Milliseconds into the current minute, from the unwrapped wall clock
+static uint16_t milliseconds_into_minute() {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return (seconds % 60) * 1000 + millis;
 }
 
 
 
-// Read settings from persistent storage
-static void load_settings() {
-  // Load the default settings
-  default_settings();
-  // Read settings from persistent storage, if they exist
-  persist_read_data(SETTINGS_KEY, &settings, sizeof(settings));
+// Sweep the second hand for the seconds timeout, if it is wanted and visible
+static void start_sweep() {
+  if (!s_face || !s_face->second_hand || !settings.SweepSeconds ||
+      !s_has_focus || !seconds_shown()) {
+    return;
+  }
+  uint32_t now = milliseconds_now();
+  s_sweep_end_ms = now + settings.SecondsTimeout * 1000;
+  if (!s_sweeping) {
+    s_sweeping = true;
+    s_sweep_position = milliseconds_into_minute();
+    s_sweep_frame_ms = 0;
+    s_sweep_timer = app_timer_register(0, sweep_timer_callback, NULL);
+    // Minute ticks are enough for the other hands while the timer runs
+    subscribe_tick_timer();
+  }
 }
 
 
 
-// Save the settings to persistent storage
-static void save_settings() {
-  // Make settings persist
-  persist_write_data(SETTINGS_KEY, &settings, sizeof(settings));
-  // Update the display based on new settings
-  update_display();
+// Back to one step per second, the hand snaps to the current second
+static void stop_sweep() {
+  if (!s_sweeping) {
+    return;
+  }
+  s_sweeping = false;
+  if (s_sweep_timer) {
+    app_timer_cancel(s_sweep_timer);
+    s_sweep_timer = NULL;
+  }
+  time_t temp = time(NULL);
+  s_time.second_step = localtime(&temp)->tm_sec;
+  if (s_second_layer) {
+    layer_mark_dirty(s_second_layer);
+  }
+  subscribe_tick_timer();
 }
 
 
 
-// Update the display elements one second after settings submission
-static void update_display() {
-  // copies a modified deinit(); to simulate a loop
-  // Destroy clock hands 
-  gpath_destroy(s_minute_arrow);
-  gpath_destroy(s_hour_arrow);
-  for (int i = 0; i < NUM_CLOCK_TICKS; ++i) {
-    gpath_destroy(s_tick_paths[i]);
+// Request one sweep frame and pace the next one
+static void sweep_timer_callback(void *data) {
+  s_sweep_timer = NULL;
+  uint32_t now = milliseconds_now();
+  if (!s_second_layer || !seconds_shown() || (int32_t)(now - s_sweep_end_ms) >= 0) {
+    stop_sweep();
+    return;
   }
-  tick_timer_service_unsubscribe();
-  // Don't Destroy Window
-  //window_destroy(s_window);
-  
-  // copies a modified init(); to simulate a loop
-  // Create main Window element and assign to pointer
-  s_window = window_create();
-  // Set handlers to manage the elements inside the Window
-  window_set_window_handlers(s_window, (WindowHandlers) {
-    .load = window_load,
-    .unload = window_unload,
-  });
 
-  // Show the Window on the watch, with animated=true
-  window_stack_push(s_window, true);
-  
-  // Register with TickTimerService, per second updates for settings change only
-  if (settings.SelectClock == 'a') {
-    //if () use && instead of a nested if
-    tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
-  } else {
-    tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+  // Position in the minute from the wall clock, never stepping backwards
+  uint16_t position = milliseconds_into_minute();
+  uint16_t advance = (position + 60000 - s_sweep_position) % 60000;
+  if (advance < 30000) {
+    s_sweep_position = position;
   }
-  
-  // Draw initial hand paths for analog
-  if (settings.SelectClock == 'a') {
-    s_minute_arrow = gpath_create(&MINUTE_HAND_POINTS);
-    s_hour_arrow = gpath_create(&HOUR_HAND_POINTS);
-    Layer *window_layer = window_get_root_layer(s_window);
-    GRect bounds = layer_get_bounds(window_layer);
-    GPoint center = grect_center_point(&bounds);
-    gpath_move_to(s_minute_arrow, center);
-    gpath_move_to(s_hour_arrow, center);
-    for (int i = 0; i < NUM_CLOCK_TICKS; ++i) {
-      s_tick_paths[i] = gpath_create(&ANALOG_BG_POINTS[i]);
-    }
-  // Make sure the time is displayed from the start for digital
-  } else if (settings.SelectClock == 'd') {
-      update_time();
-  } else {}
+  s_sweep_request_ms = now;
+  layer_mark_dirty(s_second_layer);
+
+  // Skip whole frames when the last one overran its slot
+  uint32_t interval = 1000 / (settings.SweepFps < SWEEP_MIN_FPS ? SWEEP_MIN_FPS :
+                              settings.SweepFps > SWEEP_MAX_FPS ? SWEEP_MAX_FPS : settings.SweepFps);
+  uint32_t delay = interval * (1 + s_sweep_frame_ms / interval);
+  s_sweep_timer = app_timer_register(delay, sweep_timer_callback, NULL);
 }
 
 
 
-// Handle the response from AppMessage
-static void inbox_received_handler(DictionaryIterator *iter, void *context) {
-  // Right Background Stripe Color
-  Tuple *lg_color_t = dict_find(iter, MESSAGE_KEY_LeftStripeColor);
-  if (lg_color_t) {
-    settings.LeftStripeColor = GColorFromHEX(lg_color_t->value->int32);
-  }
-  
-  // Left Background Stripe Color
-  Tuple *rg_color_t = dict_find(iter, MESSAGE_KEY_RightStripeColor);
-  if (rg_color_t) {
-    settings.RightStripeColor = GColorFromHEX(rg_color_t->value->int32);
+// Stop sweeping while a notification or another window covers the face
+static void app_focus_handler(bool in_focus) {
+  s_has_focus = in_focus;
+  if (in_focus) {
+    start_sweep();
+  } else {
+    stop_sweep();
   }
-  
-  // Watchband Middle Stripe Color
-  Tuple *bg_color_t = dict_find(iter, MESSAGE_KEY_WatchBandColor);
-  if (bg_color_t) {
-    settings.WatchBandColor = GColorFromHEX(bg_color_t->value->int32);
+}
+#else
+// Aplite always steps the second hand once a second
+static void start_sweep() {}
+static void stop_sweep() {}
+#endif
+
+
+
+// Subscribe to the tick rate the current clock type needs
+static void subscribe_tick_timer() {
+  // Faces with a second hand tick every second only while it is shown and not sweeping
+  TimeUnits unit = s_face && s_face->second_hand && seconds_shown() && !s_sweeping ?
+                   SECOND_UNIT : MINUTE_UNIT;
+
+  if (s_second_layer) {
+    layer_set_hidden(s_second_layer, !seconds_shown());
   }
-  
-  // Watchface Circle Color
-  Tuple *fg_color_t = dict_find(iter, MESSAGE_KEY_WatchFaceColor);
-  if (fg_color_t) {
-    settings.WatchFaceColor = GColorFromHEX(fg_color_t->value->int32);
+
+  // Avoid resubscribing when nothing changed
+  if (unit == s_tick_unit) {
+    return;
   }
-  
-  // Text Color
-  Tuple *tg_color_t = dict_find(iter, MESSAGE_KEY_TextColor);
-  if (tg_color_t) {
-    settings.TextColor = GColorFromHEX(tg_color_t->value->int32);
+  s_tick_unit = unit;
+  tick_timer_service_subscribe(unit, tick_handler);
+}
+
+
+
+// Create the battery meter Layer above the background
+static void create_battery_layer() {
+  s_battery_layer = layer_create(BATTERY_RECT);
+  layer_set_update_proc(s_battery_layer, battery_update_proc);
+  // Keep it directly above the background so it never covers the clock
+  layer_insert_above_sibling(s_battery_layer, s_canvas_layer);
+  // Update meter
+  layer_mark_dirty(s_battery_layer);
+}
+
+
+
+// Destroy the battery meter Layer, if any
+static void destroy_battery_layer() {
+  if (s_battery_layer) {
+    layer_destroy(s_battery_layer);
+    s_battery_layer = NULL;
   }
-  
-  // Hour/Minute Hands Color
-  Tuple *hand_color_t = dict_find(iter, MESSAGE_KEY_HandsColor);
-  if (hand_color_t) {
-    settings.HandsColor = GColorFromHEX(hand_color_t->value->int32);
+}
+
+
+
+#if defined(PBL_HEALTH)
+// Read today's steps, redrawing the complication only when the count changes
+static void refresh_steps() {
+  if (s_steps_timer) {
+    app_timer_cancel(s_steps_timer);
+    s_steps_timer = NULL;
   }
-  
-  // Second Hand Color
-  Tuple *sec_color_t = dict_find(iter, MESSAGE_KEY_SecondHandColor);
-  if (sec_color_t) {
-    settings.SecondHandColor = GColorFromHEX(sec_color_t->value->int32);
+  time_t now = time(NULL);
+  s_steps_read_time = now;
+
+  int32_t steps = -1;
+  if (health_service_metric_accessible(HealthMetricStepCount, time_start_of_today(), now) &
+      HealthServiceAccessibilityMaskAvailable) {
+    steps = health_service_sum_today(HealthMetricStepCount);
   }
-  
-  // Battery Color
-  Tuple *yg_color_t = dict_find(iter, MESSAGE_KEY_BatteryColor);
-  if (yg_color_t) {
-    settings.BatteryColor = GColorFromHEX(yg_color_t->value->int32);
+  if (steps == s_steps) {
+    return;
   }
-  
-  // Toggle Strap Holes
-  Tuple *strap_tog_t = dict_find(iter, MESSAGE_KEY_StrapDetails);
-  if (strap_tog_t) {
-    settings.StrapDetails = strap_tog_t->value->int8 == 1;
+  s_steps = steps;
+  // Format once here instead of on every frame
+  if (steps >= 0) {
+    snprintf(s_steps_text, sizeof(s_steps_text), "%ld steps", (long)steps);
+  } else {
+    s_steps_text[0] = '\0';
   }
-    
-  // Toggle Hour Markings on analog watchface
-  Tuple *hr_tog_t = dict_find(iter, MESSAGE_KEY_HourDots);
-  if (hr_tog_t) {
-    settings.HourDots = hr_tog_t->value->int8 == 1;
+  if (s_steps_layer) {
+    layer_mark_dirty(s_steps_layer);
   }
-  
-  // (Toggle) Invert Outline Color Detail
-  Tuple *out_tog_t = dict_find(iter, MESSAGE_KEY_InvertOutline);
-  if (out_tog_t) {
-    settings.InvertOutline = out_tog_t->value->int8 == 1;
+}
+
+
+
+// The rate-limited read is due
+static void steps_timer_callback(void *data) {
+  s_steps_timer = NULL;
+  refresh_steps();
+}
+
+
+
+// Read the steps after movement, at most once every STEPS_REFRESH_SECONDS
+static void schedule_steps_refresh() {
+  if (s_steps_timer) {
+    // A read is already coming and will see this movement too
+    return;
   }
-  
-  // Toggle Battery Bar
-  Tuple *battery_tog_t = dict_find(iter, MESSAGE_KEY_BatteryBarToggle);
-  if (battery_tog_t) {
-    settings.BatteryBarToggle = battery_tog_t->value->int8 == 1;
+  time_t elapsed = time(NULL) - s_steps_read_time;
+  if (elapsed >= STEPS_REFRESH_SECONDS) {
+    refresh_steps();
+  } else {
+    s_steps_timer = app_timer_register((STEPS_REFRESH_SECONDS - elapsed) * 1000,
+                                       steps_timer_callback, NULL);
   }
-  
-  // Make Selection between analog and digital
-  Tuple *select_t = dict_find(iter, MESSAGE_KEY_SelectClock);
-  if (select_t) {
-    settings.SelectClock = select_t->value->int8;
+}
+
+
+
+// Draw the cached steps text
+static void steps_update_proc(Layer *layer, GContext *ctx) {
+  RENDER_STATS_BEGIN(RenderProcSteps, layer);
+  if (s_steps_text[0]) {
+    graphics_context_set_text_color(ctx, SETTINGS_COLOR(TextColor));
+    graphics_draw_text(ctx, s_steps_text, s_steps_font, layer_get_bounds(layer),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
   }
+  RENDER_STATS_END(RenderProcSteps);
+}
 
-  // Save the new settings to persistent storage
-  save_settings();
+
+
+// Create the steps complication Layer inside the face circle
+static void create_steps_layer() {
+  s_steps_font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  s_steps_layer = layer_create(STEPS_RECT);
+  layer_set_update_proc(s_steps_layer, steps_update_proc);
+  // Below the clock layers, so the hands pass over it
+  layer_insert_above_sibling(s_steps_layer, s_canvas_layer);
+  // On launch the first read waits until health events are subscribed
+  if (s_started) {
+    refresh_steps();
+  }
 }
 
 
 
-// Get time updates and display them in 12h digital format
-static void update_time() {
-  // Get a tm structure
-  time_t temp = time(NULL);
-  struct tm *tick_time = localtime(&temp);
-
-  // Write the current hours and minutes into a buffer
-  static char s_buffer[8];
-  strftime(s_buffer, sizeof(s_buffer), clock_is_24h_style() ?
-                                          "%H:%M" : "%I:%M", tick_time);
-  // Display this time on the TextLayer
-  text_layer_set_text(s_time_layer, s_buffer);
-  
-  // Copy date into buffer from tm structure
-  static char date_buffer[16];
-  strftime(date_buffer, sizeof(date_buffer), "%b %d", tick_time);
-  // Show the date on the TextLayer
-  text_layer_set_text(s_date_layer, date_buffer);
+// Destroy the steps complication Layer, if any, and stop reading steps
+static void destroy_steps_layer() {
+  if (s_steps_timer) {
+    app_timer_cancel(s_steps_timer);
+    s_steps_timer = NULL;
+  }
+  if (s_steps_layer) {
+    layer_destroy(s_steps_layer);
+    s_steps_layer = NULL;
+  }
+}
+#else
+// Aplite has no HealthService to count steps
+static void create_steps_layer() {}
+static void destroy_steps_layer() {}
+#endif
+
+
+
+#if defined(DIGIT_ATLAS)
+// Point the atlas ink at the text color, the rest of the strip stays clear
+static void recolor_digits() {
+#if !defined(PBL_PLATFORM_APLITE)
+  GColor *palette = gbitmap_get_palette(s_atlas_bitmap);
+  palette[s_atlas_ink] = SETTINGS_COLOR(TextColor);
+  palette[!s_atlas_ink] = GColorClear;
+#endif
 }
 
 
 
-// Necessary for time updates
-static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
-  // Update time
-  update_time();
+// Show a new time, only the characters that changed get a new sprite
+static void set_digits(const char *text) {
+  size_t length = strlen(text);
+  if (length > DIGIT_ATLAS_MAX_CHARS) {
+    length = DIGIT_ATLAS_MAX_CHARS;
+  }
+  if (strncmp(text, s_digits, length) == 0 && s_digits[length] == '\0') {
+    return;
+  }
+
+  int16_t width = 0;
+  for (size_t i = 0; i < length; ++i) {
+    char c = text[i];
+    int16_t cell_width = c == ':' ? DIGIT_ATLAS_COLON_WIDTH : DIGIT_ATLAS_DIGIT_WIDTH;
+    if (c != s_digits[i]) {
+      s_digit_sprites[i] = s_atlas_cells[c == ':' ? DIGIT_ATLAS_COLON : c - '0'];
+    }
+    s_digit_rects[i] = GRect(width, DIGIT_ATLAS_TOP, cell_width, DIGIT_ATLAS_HEIGHT);
+    width += cell_width;
+  }
+  strncpy(s_digits, text, length);
+  s_digits[length] = '\0';
+
+  // Center the run of cells the way the TextLayer centered the text
+  int16_t left = (TIME_TEXT_RECT.size.w - width) / 2;
+  for (size_t i = 0; i < length; ++i) {
+    s_digit_rects[i].origin.x += left;
+  }
+  layer_mark_dirty(s_digits_layer);
 }
 
 
 
-// Record Battery Level
-static void battery_callback(BatteryChargeState state) {
-  // Record the new battery level
-  s_battery_level = state.charge_percent;
+// Draw the time from the atlas cells
+static void digits_update_proc(Layer *layer, GContext *ctx) {
+  RENDER_STATS_BEGIN(RenderProcDigits, layer);
+#if defined(PBL_PLATFORM_APLITE)
+  // 1-bit sprites: AND keeps the black ink, SET paints the ink white
+  graphics_context_set_compositing_mode(ctx, gcolor_equal(SETTINGS_COLOR(TextColor), GColorWhite) ?
+                                             GCompOpSet : GCompOpAnd);
+#else
+  // Palette sprites, the clear entry lets the background through
+  graphics_context_set_compositing_mode(ctx, GCompOpSet);
+#endif
+  for (size_t i = 0; s_digits[i]; ++i) {
+    graphics_draw_bitmap_in_rect(ctx, s_digit_sprites[i], s_digit_rects[i]);
+  }
+  RENDER_STATS_END(RenderProcDigits);
 }
 
 
 
-// Draw battery meter
-static void battery_update_proc(Layer *layer, GContext *ctx) {
-  // Find bounds
-  GRect bounds = layer_get_bounds(layer);
-  // Find the arclength of the battery circle
-  int arcangle = (int)(float)(((float)s_battery_level / 100.0F) * 360.0F);
-  // Angles
-  uint16_t angle_start = DEG_TO_TRIGANGLE(0);
-  uint16_t angle_end = DEG_TO_TRIGANGLE(arcangle);
-  
-  // Draw the battery arc
-  graphics_context_set_stroke_color(ctx, settings.BatteryColor);
-  graphics_context_set_stroke_width(ctx, 5);
-  graphics_draw_arc(ctx, bounds, GOvalScaleModeFitCircle, angle_start, angle_end);
+// Load the digit atlas and cut it into one sub-bitmap per character
+static void load_digit_atlas() {
+  s_atlas_bitmap = gbitmap_create_with_resource(RESOURCE_ID_DIGIT_ATLAS);
+#if !defined(PBL_PLATFORM_APLITE)
+  s_atlas_ink = gcolor_equal(gbitmap_get_palette(s_atlas_bitmap)[0], GColorBlack) ? 0 : 1;
+#endif
+  recolor_digits();
+  for (int i = 0; i < DIGIT_ATLAS_CELLS; ++i) {
+    GRect cell = i == DIGIT_ATLAS_COLON ?
+        GRect(i * DIGIT_ATLAS_DIGIT_WIDTH, 0, DIGIT_ATLAS_COLON_WIDTH, DIGIT_ATLAS_HEIGHT) :
+        GRect(i * DIGIT_ATLAS_DIGIT_WIDTH, 0, DIGIT_ATLAS_DIGIT_WIDTH, DIGIT_ATLAS_HEIGHT);
+    s_atlas_cells[i] = gbitmap_create_as_sub_bitmap(s_atlas_bitmap, cell);
+  }
+  // Forget every character, so set_digits can't keep a sprite of the old atlas
+  memset(s_digits, 0, sizeof(s_digits));
 }
 
 
 
-// Draw background
-static void canvas_update_proc(Layer *layer, GContext *ctx) {
-  // Custom background layer drawing happens here
-  // Screen size is 144 x 168 pixels (x_max, -y_max) for Aplite, Basalt
-  // Screen size is 180 x 180 pixels (x_max, -y_max) for Chalk (+36, +12)
-  
-  // Rounded rectangle corner radius
-  uint8_t no_corner_radius = 0;
-  // Set center for all watchtypes
-  GPoint center = GPoint(PBL_IF_ROUND_ELSE(90, 72), PBL_IF_ROUND_ELSE(90, 84));
-  
-  // Fill the left rectangle
-  // Set the fill color and rectangle bounds 
-  graphics_context_set_fill_color(ctx, settings.LeftStripeColor);
-  GRect left_rect_bounds = GRect(0, 0, PBL_IF_ROUND_ELSE(66, 48), PBL_IF_ROUND_ELSE(180, 168));
-  graphics_fill_rect(ctx, left_rect_bounds, no_corner_radius, GCornersAll);
-  
-  // Fill the middle rectangle
-  graphics_context_set_fill_color(ctx, settings.WatchBandColor);
-  GRect middle_rect_bounds = GRect(PBL_IF_ROUND_ELSE(66, 48), 0, 48, PBL_IF_ROUND_ELSE(180, 168));
-  graphics_fill_rect(ctx, middle_rect_bounds, no_corner_radius, GCornersAll);
-  
-  // Fill the right rectangle
-  graphics_context_set_fill_color(ctx, settings.RightStripeColor);
-  GRect right_rect_bounds = GRect(PBL_IF_ROUND_ELSE(114, 96), 0, PBL_IF_ROUND_ELSE(66, 48), PBL_IF_ROUND_ELSE(180, 168));
-  graphics_fill_rect(ctx, right_rect_bounds, no_corner_radius, GCornersAll);
-  
-  // Draw two lines
-  if (settings.StrapDetails) {
-    if (settings.InvertOutline) {
-      graphics_context_set_stroke_color(ctx, GColorWhite);
-    } else {
-      graphics_context_set_stroke_color(ctx, GColorBlack);
-    }
-    graphics_context_set_stroke_width(ctx, 3);
-    GPoint startleft = GPoint(PBL_IF_ROUND_ELSE(66, 48), 0);
-    GPoint endleft = GPoint(PBL_IF_ROUND_ELSE(66, 48), PBL_IF_ROUND_ELSE(180, 168));
-    graphics_draw_line(ctx, startleft, endleft);
-    GPoint startright = GPoint(PBL_IF_ROUND_ELSE(114, 96), 0);
-    GPoint endright = GPoint(PBL_IF_ROUND_ELSE(114, 96), PBL_IF_ROUND_ELSE(180, 168));
-    graphics_draw_line(ctx, startright, endright);
+// Release the atlas and its cells
+static void unload_digit_atlas() {
+  for (int i = 0; i < DIGIT_ATLAS_CELLS; ++i) {
+    gbitmap_destroy(s_atlas_cells[i]);
+    s_atlas_cells[i] = NULL;
   }
-  
-  // Draw a circle 
-  if (settings.InvertOutline) {
-    graphics_context_set_stroke_color(ctx, GColorWhite);
-  } else {
-    graphics_context_set_stroke_color(ctx, GColorBlack);
-  }
-  graphics_context_set_fill_color(ctx, settings.WatchFaceColor);
-  // Set the stroke width (must be an odd integer value)
-  graphics_context_set_stroke_width(ctx, 7);
-  // Set radius
-  uint8_t radius = 54;
-  // Draw the outline of a circle
-  graphics_draw_circle(ctx, center, radius);
-  // Fill a circle
-  graphics_fill_circle(ctx, center, radius);
-  
-  // Draw small dots around circle if option is selected
-  if (settings.StrapDetails) {
-    uint8_t small_radius = 2;
-    graphics_context_set_stroke_width(ctx, 7);
-    graphics_context_set_fill_color(ctx, settings.WatchBandColor);
-    GPoint cen6 = GPoint(PBL_IF_ROUND_ELSE(90, 72), PBL_IF_ROUND_ELSE(164, 158));
-    GPoint cen12 = GPoint(PBL_IF_ROUND_ELSE(90, 72), PBL_IF_ROUND_ELSE(16, 10));
-    graphics_draw_circle(ctx, cen6, small_radius);
-    graphics_fill_circle(ctx, cen6, small_radius);
-    graphics_draw_circle(ctx, cen12, small_radius);
-    graphics_fill_circle(ctx, cen12, small_radius);
-  } else {}
-  
-  if (settings.SelectClock == 'a' && settings.HourDots) {
-    uint8_t small_radius = 2;
-    // Draw hour placements for analog clock
-    GPoint center1 = GPoint(PBL_IF_ROUND_ELSE(122, 104), PBL_IF_ROUND_ELSE(34, 28));
-    GPoint center2 = GPoint(PBL_IF_ROUND_ELSE(146, 128), PBL_IF_ROUND_ELSE(58, 52));
-    GPoint center3 = GPoint(PBL_IF_ROUND_ELSE(154, 136), PBL_IF_ROUND_ELSE(90, 84));
-    GPoint center4 = GPoint(PBL_IF_ROUND_ELSE(146, 128), PBL_IF_ROUND_ELSE(122, 116));
-    GPoint center5 = GPoint(PBL_IF_ROUND_ELSE(122, 104), PBL_IF_ROUND_ELSE(146, 140));
-    GPoint center6 = GPoint(PBL_IF_ROUND_ELSE(90, 72), PBL_IF_ROUND_ELSE(154, 148));
-    GPoint center7 = GPoint(PBL_IF_ROUND_ELSE(58, 40), PBL_IF_ROUND_ELSE(146, 140));
-    GPoint center8 = GPoint(PBL_IF_ROUND_ELSE(34, 16), PBL_IF_ROUND_ELSE(122, 116));
-    GPoint center9 = GPoint(PBL_IF_ROUND_ELSE(26, 8), PBL_IF_ROUND_ELSE(90, 84));
-    GPoint center10 = GPoint(PBL_IF_ROUND_ELSE(34, 16), PBL_IF_ROUND_ELSE(58, 52));
-    GPoint center11 = GPoint(PBL_IF_ROUND_ELSE(58, 40), PBL_IF_ROUND_ELSE(34, 28));
-    GPoint center12 = GPoint(PBL_IF_ROUND_ELSE(90, 72), PBL_IF_ROUND_ELSE(26, 20));
-
-    if (settings.InvertOutline) {
-      graphics_context_set_fill_color(ctx, GColorWhite);
-    } else {
-      graphics_context_set_fill_color(ctx, GColorBlack);
-    }
-    graphics_fill_circle(ctx, center1, small_radius);
-    graphics_fill_circle(ctx, center2, small_radius);
-    graphics_fill_circle(ctx, center3, small_radius);
-    graphics_fill_circle(ctx, center4, small_radius);
-    graphics_fill_circle(ctx, center5, small_radius);
-    graphics_fill_circle(ctx, center6, small_radius);
-    graphics_fill_circle(ctx, center7, small_radius);
-    graphics_fill_circle(ctx, center8, small_radius);
-    graphics_fill_circle(ctx, center9, small_radius);
-    graphics_fill_circle(ctx, center10, small_radius);
-    graphics_fill_circle(ctx, center11, small_radius);
-    graphics_fill_circle(ctx, center12, small_radius);
-  } else{}
+  gbitmap_destroy(s_atlas_bitmap);
+  s_atlas_bitmap = NULL;
 }
+#endif
 
 
 
-// Draw analog watchface hands layer
-static void hands_update_proc(Layer *layer, GContext *ctx) {
-  GRect bounds = layer_get_bounds(layer);
-  GPoint center = grect_center_point(&bounds);
+// Find the face for a clock type, unknown types get the default face
+static const Face *face_for(char clock) {
+  for (size_t i = 0; i < ARRAY_LENGTH(FACES); ++i) {
+    if (FACES[i].clock == clock) {
+      return &FACES[i];
+    }
+  }
+  return &FACES[0];
+}
 
-  const uint8_t second_hand_length = 50;
 
-  time_t now = time(NULL);
-  struct tm *t = localtime(&now);
-  uint16_t second_angle = TRIG_MAX_ANGLE * t->tm_sec / 60; 
-  //int32_t previously
-  
-  GPoint second_hand = {
-    .x = (int16_t)(sin_lookup(second_angle) * (uint16_t)second_hand_length / TRIG_MAX_RATIO) + center.x,
-    //int16_t and int32_t previously
-    .y = (int16_t)(-cos_lookup(second_angle) * (uint16_t)second_hand_length / TRIG_MAX_RATIO) + center.y,
-  };
 
-  // minute/hour hand
-  graphics_context_set_fill_color(ctx, settings.HandsColor);
-  graphics_context_set_stroke_color(ctx, settings.HandsColor);
-  graphics_context_set_stroke_width(ctx, 5);
+// Create the layers and load the resources of the selected face, nothing else
+static void create_face_layers(Layer *window_layer) {
+  GRect bounds = layer_get_bounds(window_layer);
+  RENDER_STATS_MODE(settings.SelectClock);
+
+  s_face = face_for(settings.SelectClock);
+  for (int i = 0; i < s_face->num_layers; ++i) {
+    const FaceLayer *spec = &s_face->layers[i];
+    GRect frame = spec->frame ? *spec->frame : bounds;
+    if (spec->load) {
+      spec->load();
+    }
 
-  gpath_rotate_to(s_hour_arrow, (TRIG_MAX_ANGLE * (((t->tm_hour % 12) * 6) + (t->tm_min / 10))) / (12 * 6));
-  gpath_draw_filled(ctx, s_hour_arrow);
-  gpath_draw_outline(ctx, s_hour_arrow);
-  
-  graphics_context_set_fill_color(ctx, settings.HandsColor);
-  graphics_context_set_stroke_color(ctx, settings.HandsColor);
-  
-  gpath_rotate_to(s_minute_arrow, TRIG_MAX_ANGLE * t->tm_min / 60);
-  gpath_draw_filled(ctx, s_minute_arrow);
-  gpath_draw_outline(ctx, s_minute_arrow);
-  
-  // second hand
-  graphics_context_set_stroke_color(ctx, settings.SecondHandColor);
-  graphics_context_set_stroke_width(ctx, 3);
-  graphics_draw_line(ctx, second_hand, center);
+    if (spec->type == FaceLayerText) {
+      TextLayer *text_layer = text_layer_create(frame);
+      // Improve the layout to be more like a watchface
+      text_layer_set_text_alignment(text_layer, GTextAlignmentCenter);
+      text_layer_set_text_color(text_layer, SETTINGS_COLOR(TextColor));
+      text_layer_set_background_color(text_layer, GColorClear);
+      *spec->font = fonts_load_custom_font(resource_get_handle(spec->font_resource));
+      text_layer_set_font(text_layer, *spec->font);
+      layer_add_child(window_layer, text_layer_get_layer(text_layer));
+      *spec->text_layer = text_layer;
+    } else {
+      Layer *layer = layer_create(frame);
+      layer_set_update_proc(layer, spec->update_proc);
+      layer_add_child(window_layer, layer);
+      *spec->layer = layer;
+    }
+  }
 
-  // dot in the middle
-  graphics_context_set_fill_color(ctx, settings.SecondHandColor);
-  graphics_fill_circle(ctx, center, 3);
+  // Make sure the time is displayed from the start
+  refresh_time(FACE_TIME_UNITS);
+
+  // The pixel-diff probe has to stay above the face layers
+  RENDER_STATS_ATTACH(window_layer, frame_pixels);
 }
 
 
 
-// Update per second instead of per minute
-static void handle_second_tick(struct tm *tick_time, TimeUnits units_changed) {
-  layer_mark_dirty(window_get_root_layer(s_window));
+// Destroy exactly what create_face_layers made for the current face
+static void destroy_face_layers() {
+  if (!s_face) {
+    return;
+  }
+  for (int i = s_face->num_layers - 1; i >= 0; --i) {
+    const FaceLayer *spec = &s_face->layers[i];
+    if (spec->type == FaceLayerText) {
+      text_layer_destroy(*spec->text_layer);
+      fonts_unload_custom_font(*spec->font);
+      *spec->text_layer = NULL;
+      *spec->font = NULL;
+    } else {
+      layer_destroy(*spec->layer);
+      *spec->layer = NULL;
+    }
+    if (spec->unload) {
+      spec->unload();
+    }
+  }
+  s_face = NULL;
 }
 
 
@@ -425,81 +1622,299 @@ static void window_load(Window *window) {
   // Assign the custom drawing procedure
   layer_set_update_proc(s_canvas_layer, canvas_update_proc);
   // Add to Window
-  layer_add_child(window_get_root_layer(window), s_canvas_layer);
+  layer_add_child(window_layer, s_canvas_layer);
   // Mark for redrawing at the earliest opportunity
-  layer_mark_dirty(s_canvas_layer);
+  invalidate_background();
   
   // Create battery meter Layer if battery bar is toggled on
   if(settings.BatteryBarToggle) {
-    s_battery_layer = layer_create(GRect(PBL_IF_ROUND_ELSE(42, 24), PBL_IF_ROUND_ELSE(42, 36), 96, 96));
-    layer_set_update_proc(s_battery_layer, battery_update_proc);
-    // Add to Window
-    layer_add_child(window_get_root_layer(window), s_battery_layer);
-    // Update meter
-    layer_mark_dirty(s_battery_layer);
+    create_battery_layer();
   } else {}
+  if (settings.StepsComplication) {
+    create_steps_layer();
+  }
   
-  // If Digital clockface is selected
-  if (settings.SelectClock == 'd') {    
-    // Create the TextLayer with specific bounds
-    s_time_layer = text_layer_create(
-        GRect(0, PBL_IF_ROUND_ELSE(58, 52), bounds.size.w, 50));
-    // Improve the layout to be more like a watchface
-    text_layer_set_text_alignment(s_time_layer, GTextAlignmentCenter);
-    text_layer_set_text_color(s_time_layer, settings.TextColor);
-    text_layer_set_background_color(s_time_layer, GColorClear);
-    // Create GFont for time and apply GFont to TextLayer
-    s_time_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_NOTO_SANS_BOLD_36));
-    text_layer_set_font(s_time_layer, s_time_font);
-    // Add it as a child layer to the Window's root layer
-    layer_add_child(window_layer, text_layer_get_layer(s_time_layer));
-    
-    // Create date TextLayer
-    s_date_layer = text_layer_create(
-        GRect(0, PBL_IF_ROUND_ELSE(96, 90), bounds.size.w, 50));
-    // Improve layout
-    text_layer_set_text_alignment(s_date_layer, GTextAlignmentCenter);
-    text_layer_set_text_color(s_date_layer, settings.TextColor);
-    text_layer_set_background_color(s_date_layer, GColorClear);
-    // Create GFont for date and apply GFont to TextLayer
-    s_date_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_NOTO_SANS_REGULAR_18));
-    text_layer_set_font(s_date_layer, s_date_font);
-    // Add to Window
-    layer_add_child(window_get_root_layer(window), text_layer_get_layer(s_date_layer));
-  // If Analog clockface is selected
-  } else if (settings.SelectClock == 'a') {
-    s_hands_layer = layer_create(bounds);
-    layer_set_update_proc(s_hands_layer, hands_update_proc);
-    layer_add_child(window_layer, s_hands_layer);
-  } else{}
+  // Create the digital or analog clock
+  create_face_layers(window_layer);
+  RENDER_STATS_HEAP("load");
 }
 
 
 
 // Window Unload event
 static void window_unload(Window *window) {
-  // Unload GFonts
-  fonts_unload_custom_font(s_time_font);
-  fonts_unload_custom_font(s_date_font);
-  // Destroy TextLayers
-  text_layer_destroy(s_time_layer);
-  text_layer_destroy(s_date_layer);
+  RENDER_STATS_DETACH();
+  // Destroy clock layers, fonts and paths
+  destroy_face_layers();
   // Destroy Layers
-  layer_destroy(s_hands_layer);
-  layer_destroy(s_battery_layer);
+  destroy_battery_layer();
+  destroy_steps_layer();
   layer_destroy(s_canvas_layer);
+  s_canvas_layer = NULL;
+  // Release the cached background
+  invalidate_background();
+  RENDER_STATS_HEAP("unload");
+}
+
+
+
+#if defined(RENDER_STATS)
+// Pixels the update procs cover in one frame, every visible layer redraws
+static uint32_t frame_pixels() {
+  Layer *layers[] = {
+    s_canvas_layer, s_battery_layer, s_steps_layer, s_hands_layer, s_second_layer,
+#if defined(DIGIT_ATLAS)
+    s_digits_layer,
+#else
+    s_time_layer ? text_layer_get_layer(s_time_layer) : NULL,
+#endif
+    s_date_layer ? text_layer_get_layer(s_date_layer) : NULL,
+  };
+  uint32_t pixels = 0;
+  for (size_t i = 0; i < ARRAY_LENGTH(layers); ++i) {
+    if (layers[i] && !layer_get_hidden(layers[i])) {
+      GRect bounds = layer_get_bounds(layers[i]);
+      pixels += bounds.size.w * bounds.size.h;
+    }
+  }
+  return pixels;
+}
+#endif
+
+
+
+#if defined(RENDER_STATS) && !defined(SETTINGS_SOAK)
+// Start the simulated day over, dropping a run that is still going
+static void start_simulation() {
+  if (s_sim_timer) {
+    app_timer_cancel(s_sim_timer);
+  }
+  s_sim_second = 0;
+  s_sim_timer = app_timer_register(SIM_START_DELAY_MS, simulate_day, NULL);
+}
+
+
+
+// Fast-forward a day through the tick, battery, night mode and settings save
+// paths, one batch of simulated seconds per timer so frames and events go on
+static void simulate_day(void *data) {
+  if (s_sim_second == 0) {
+    render_stats_day_begin();
+    s_sim_seconds_left = 0;
+  }
+
+  // Simulated time starts at midnight, battery drains over the day
+  struct tm t = { .tm_mday = 1, .tm_year = 116 };
+  int batch_end = s_sim_second + SIM_BATCH_SECONDS;
+  if (batch_end > SIM_DAY_SECONDS) {
+    batch_end = SIM_DAY_SECONDS;
+  }
+  for (int second = s_sim_second; second < batch_end; ++second) {
+    t.tm_hour = second / 3600;
+    t.tm_min = second / 60 % 60;
+    t.tm_sec = second % 60;
+    TimeUnits changed = SECOND_UNIT;
+    if (t.tm_sec == 0) {
+      changed |= MINUTE_UNIT;
+      if (t.tm_min == 0) {
+        changed |= HOUR_UNIT;
+        // Midnight also turns the date
+        if (t.tm_hour == 0) {
+          changed |= DAY_UNIT;
+        }
+      }
+    }
+
+    // Battery reports come in 10% steps
+    if (second % SIM_BATTERY_STEP_SECONDS == 0) {
+      render_stats_wakeup();
+      battery_callback((BatteryChargeState) {
+        .charge_percent = 100 - 10 * (second / SIM_BATTERY_STEP_SECONDS),
+      });
+      render_stats_wakeup_end(frame_pixels());
+    }
+
+    // Wrist flicks wake the adaptive second hand, its AppTimer is simulated
+    if (s_face && s_face->second_hand && settings.AdaptiveSeconds) {
+      if (second % SIM_FLICK_INTERVAL_SECONDS == 0) {
+        render_stats_wakeup();
+        accel_tap_handler(ACCEL_AXIS_X, 1);
+        if (s_seconds_timer) {
+          app_timer_cancel(s_seconds_timer);
+          s_seconds_timer = NULL;
+        }
+        s_sim_seconds_left = settings.SecondsTimeout;
+        render_stats_wakeup_end(frame_pixels());
+      } else if (s_sim_seconds_left && --s_sim_seconds_left == 0) {
+        render_stats_wakeup();
+        seconds_timeout_callback(NULL);
+        render_stats_wakeup_end(frame_pixels());
+      }
+    }
+
+    // A settings change from the phone, counted as the write save_settings
+    // would make without touching the settings in flash
+    if (second == SIM_SETTINGS_SAVE_SECOND) {
+      render_stats_wakeup();
+      render_stats_flash_write();
+      render_stats_wakeup_end(frame_pixels());
+    }
+
+    // The tick service only wakes us for the unit we subscribed to
+    if (changed & s_tick_unit) {
+      render_stats_wakeup();
+      tick_handler(&t, changed);
+      render_stats_wakeup_end(frame_pixels());
+    }
+  }
+  s_sim_second = batch_end;
+  if (s_sim_second < SIM_DAY_SECONDS) {
+    s_sim_timer = app_timer_register(SIM_BATCH_INTERVAL_MS, simulate_day, NULL);
+    return;
+  }
+
+  static char s_config[64];
+  snprintf(s_config, sizeof(s_config), "clock=%c adaptive=%d battery=%d strap=%d dots=%d night=%d",
+           settings.SelectClock, settings.AdaptiveSeconds, settings.BatteryBarToggle,
+           settings.StrapDetails, settings.HourDots, settings.NightMode);
+  render_stats_day_report(s_config);
+  end_simulation();
+}
+
+
+
+// Back to the real time, battery and second hand state after the simulated day
+static void end_simulation() {
+  s_sim_timer = NULL;
+  battery_callback(battery_state_service_peek());
+  time_t temp = time(NULL);
+  update_night_mode(localtime(&temp));
+  configure_seconds_mode();
+  refresh_time(FACE_TIME_UNITS);
+}
+#endif
+
+
+
+#if defined(SETTINGS_SOAK)
+// Deliver a settings blob the same way the phone does
+static void soak_message(const uint8_t *data, uint16_t length) {
+  // Dictionary header, one tuple header and the blob
+  uint8_t buffer[1 + 7 + SETTINGS_MESSAGE_SIZE];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_data(&iter, MESSAGE_KEY_SettingsBlob, data, length);
+  uint32_t size = dict_write_end(&iter);
+  dict_read_begin_from_buffer(&iter, buffer, size);
+  inbox_received_handler(&iter, NULL);
+}
+
+
+
+// Take the window through unload and load, covered so the stack never empties
+static void soak_window() {
+  Window *cover = window_create();
+  window_stack_push(cover, false);
+  window_stack_remove(s_window, false);
+  window_stack_push(s_window, false);
+  window_stack_remove(cover, false);
+  window_destroy(cover);
+}
+
+
+
+// Check the heap and object counts once the original settings have redrawn
+static void soak_report(void *data) {
+  render_stats_soak_report(s_soak_sent);
+}
+
+
+
+// Replay batches of random settings messages, frames are drawn in between
+static void soak_settings(void *data) {
+  if (s_soak_sent == 0) {
+    encode_settings_message(s_soak_original);
+    render_stats_soak_begin();
+  }
+
+  // rand() is never seeded, so every run replays the same messages
+  for (int i = 0; i < SOAK_BATCH && s_soak_sent < SOAK_MESSAGES; ++i) {
+    uint8_t message[SETTINGS_MESSAGE_SIZE];
+    for (size_t j = 0; j < sizeof(message); ++j) {
+      message[j] = rand();
+    }
+    // Mostly well formed, sometimes a stale version, unknown clock or short message
+    if (rand() % 16) {
+      message[0] = SETTINGS_MESSAGE_VERSION;
+    }
+    if (rand() % 16) {
+      message[1] = rand() % 2 ? 'a' : 'd';
+    }
+    uint16_t length = rand() % 8 ? sizeof(message) : 1 + rand() % sizeof(message);
+    soak_message(message, length);
+
+    if (++s_soak_sent % SOAK_WINDOW_INTERVAL == 0) {
+      soak_window();
+    }
+  }
+
+  if (s_soak_sent < SOAK_MESSAGES) {
+    app_timer_register(SOAK_INTERVAL_MS, soak_settings, NULL);
+  } else {
+    soak_message(s_soak_original, sizeof(s_soak_original));
+    app_timer_register(SOAK_INTERVAL_MS, soak_report, NULL);
+  }
+}
+#endif
+
+
+
+// Second launch stage, run after the first frame: everything that frame
+// doesn't depend on
+static void finish_startup(void *data) {
+  s_startup_timer = NULL;
+  s_started = true;
+
+  // Room for exactly one settings message in, one settings hash out
+  app_message_open(dict_calc_buffer_size(1, SETTINGS_MESSAGE_SIZE),
+                   dict_calc_buffer_size(2, sizeof(uint32_t), sizeof(uint8_t)));
+  // Let the phone know which settings we have
+  update_settings_hash();
+  send_settings_hash();
+
+  // Register for battery level updates, init already used the current level
+  battery_state_service_subscribe(battery_callback);
+#if defined(PBL_HEALTH)
+  // Follow sleep state for night mode and steps, aplite only has the quiet hours
+  health_service_events_subscribe(health_handler, NULL);
+  if (s_steps_layer) {
+    refresh_steps();
+  }
+#endif
+#if defined(SWEEP_SUPPORTED)
+  // Sweeping stops while something covers the face
+  app_focus_service_subscribe(app_focus_handler);
+#endif
+  RENDER_STATS_STARTED();
 }
 
 
 
-// Initialize
+// Initialize just what the first frame needs, finish_startup does the rest
 static void init(void) {
+  RENDER_STATS_LAUNCH();
   // Load settings
   load_settings();
   
-  // Listen for AppMessages
+  // Listen for AppMessages, the channel itself opens after the first frame
   app_message_register_inbox_received(inbox_received_handler);
-  app_message_open(128, 128);
+  app_message_register_outbox_failed(outbox_failed_handler);
+
+  // The battery level picks the power profile the first frame is drawn in
+  battery_callback(battery_state_service_peek());
+  // Start in night mode if we launch while asleep or in the quiet hours
+  time_t temp = time(NULL);
+  update_night_mode(localtime(&temp));
 
   // Create main Window element and assign to pointer
   s_window = window_create();
@@ -509,57 +1924,35 @@ static void init(void) {
     .unload = window_unload,
   });
 
-  // Show the Window on the watch, with animated=true
-  window_stack_push(s_window, true);
-  
-  // Register for battery level updates
-  battery_state_service_subscribe(battery_callback);
-  // Ensure battery level is displayed from the start
-  battery_callback(battery_state_service_peek());
-  
-  // Register with TickTimerService, minute_unit for digital/analog, second_unit for analog only
-  if (settings.SelectClock == 'a') {
-    // Analog will always show seconds
-    tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
-  } else {
-    tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
-  }
+  // Show the Window on the watch, without an animation to wait for
+  window_stack_push(s_window, false);
   
-  // Draw initial hand paths 
-  if (settings.SelectClock == 'a') {
-    s_minute_arrow = gpath_create(&MINUTE_HAND_POINTS);
-    s_hour_arrow = gpath_create(&HOUR_HAND_POINTS);
-
-    Layer *window_layer = window_get_root_layer(s_window);
-    GRect bounds = layer_get_bounds(window_layer);
-    GPoint center = grect_center_point(&bounds);
-    gpath_move_to(s_minute_arrow, center);
-    gpath_move_to(s_hour_arrow, center);
-
-    for (int i = 0; i < NUM_CLOCK_TICKS; ++i) {
-      s_tick_paths[i] = gpath_create(&ANALOG_BG_POINTS[i]);
-    }
-  // Make sure the time is displayed from the start
-  } else if (settings.SelectClock == 'd') {
-    update_time();
-  } else{}
+  // Register with TickTimerService, minute_unit for digital, second_unit for analog
+  configure_seconds_mode();
+#if defined(SETTINGS_SOAK)
+  app_timer_register(SIM_START_DELAY_MS, soak_settings, NULL);
+#elif defined(RENDER_STATS)
+  start_simulation();
+#endif
 }
 
 
 
 // Shut down
 static void deinit(void) {
-  // Destroy clock hands 
-  gpath_destroy(s_minute_arrow);
-  gpath_destroy(s_hour_arrow);
-  
-  for (int i = 0; i < NUM_CLOCK_TICKS; ++i) {
-    gpath_destroy(s_tick_paths[i]);
+  if (s_startup_timer) {
+    app_timer_cancel(s_startup_timer);
   }
-  
   tick_timer_service_unsubscribe();
+  accel_tap_service_unsubscribe();
+#if defined(SWEEP_SUPPORTED)
+  app_focus_service_unsubscribe();
+#endif
+#if defined(PBL_HEALTH)
+  health_service_events_unsubscribe();
+#endif
   
-  // Destroy Window
+  // Destroy Window (unload releases its layers, fonts and paths)
   window_destroy(s_window);
 }
 
@@ -570,4 +1963,5 @@ int main(void) {
   init();
   app_event_loop();
   deinit();
+  return 0;
 }
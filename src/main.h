@@ -1,13 +1,135 @@
 #include <pebble.h>
 #pragma once
 
+// Raw ClaySettings struct written by 1.0, migrated on first load
 #define SETTINGS_KEY 1
-#define NUM_CLOCK_TICKS 11
+// Versioned, packed settings (see PersistedSettings)
+#define SETTINGS_BLOB_KEY 2
+#define SETTINGS_SCHEMA_VERSION 1
+// Palettized background cache holds at most a 4-bit palette
+#define MAX_BACKGROUND_COLORS 16
+
+// Digit sprite strip for the time, DIGIT_ATLAS=1 builds (see tools/digit_atlas.py).
+// Cells are '0' to '9' then ':', the top is measured from the time text box.
+#define DIGIT_ATLAS_CELLS 11
+#define DIGIT_ATLAS_COLON 10
+#define DIGIT_ATLAS_DIGIT_WIDTH 21
+#define DIGIT_ATLAS_COLON_WIDTH 10
+#define DIGIT_ATLAS_HEIGHT 27
+#define DIGIT_ATLAS_TOP 12
+// "HH:MM"
+#define DIGIT_ATLAS_MAX_CHARS 5
+
+// Offset of a hand tip from the center of the face
+typedef struct {
+  int8_t x;
+  int8_t y;
+} HandOffset;
+
+// Generated layout, hand positions and battery arc angles (see wscript)
+#include "geometry.h"
+
+// Power profiles, from full detail down to a simplified face
+typedef enum {
+  PowerProfileFull,     // everything drawn, seconds as configured
+  PowerProfileSaver,    // minute ticks only, second hand hidden
+  PowerProfileMinimal   // also drops strap details and hour dots
+} PowerProfile;
+
+// Room in the background display list, the busiest face needs about 30 ops
+#define MAX_BACKGROUND_OPS 40
+
+// Background drawing ops, the first three change the context state
+typedef enum {
+  DrawOpFillColor,
+  DrawOpStrokeColor,
+  DrawOpStrokeWidth,
+  DrawOpFillRect,
+  DrawOpDrawLine,
+  DrawOpDrawCircle,
+  DrawOpFillCircle
+} DrawOpType;
+
+#define NUM_DRAW_STATES (DrawOpStrokeWidth + 1)
+
+// One op: a resolved color, stroke width or radius in value, and up to two
+// points (rect origin and size, line ends or circle center)
+typedef struct {
+  uint8_t type;
+  uint8_t value;
+  GPoint a;
+  GPoint b;
+} DrawOp;
+
+// Display list, with the context state it leaves behind while it is built
+typedef struct {
+  DrawOp ops[MAX_BACKGROUND_OPS];
+  uint8_t count;
+  bool valid;
+  bool state_known[NUM_DRAW_STATES];
+  uint8_t state[NUM_DRAW_STATES];
+} DrawList;
+
+// Time derived values shared by the face layers, see tick_handler
+typedef struct {
+  char time_text[8];
+  char date_text[16];
+  // Indexes into the hand tables
+  uint16_t hour_step;
+  uint8_t minute_step;
+  uint8_t second_step;
+} TimeState;
+
+// Something that needs updating when any of the given time units change
+typedef struct {
+  TimeUnits units;
+  void (*update)(struct tm *t);
+} TickConsumer;
+
+// Units the face layers draw from, everything but the hourly night mode check
+#define FACE_TIME_UNITS (SECOND_UNIT | MINUTE_UNIT | DAY_UNIT)
+
+// Most layers any face needs
+#define FACE_MAX_LAYERS 3
+
+typedef enum {
+  FaceLayerCanvas,  // custom layer drawn by update_proc
+  FaceLayerText     // TextLayer in the text color with its own font
+} FaceLayerType;
+
+// One layer of a face, created in order and destroyed in reverse
+typedef struct {
+  FaceLayerType type;
+  // Frame inside the window, NULL for the whole window
+  const GRect *frame;
+  LayerUpdateProc update_proc;
+  // Where the layer lives while the face is shown, consumers check it for NULL
+  Layer **layer;
+  TextLayer **text_layer;
+  // Font resource and where the loaded font is kept, text layers only
+  uint32_t font_resource;
+  GFont *font;
+  // Load and release any other resources the layer draws from
+  void (*load)(void);
+  void (*unload)(void);
+} FaceLayer;
+
+// A clock face: what SelectClock picks, how it ticks and what it is made of
+typedef struct {
+  char clock;
+  // Shows a second hand, ticking every second while it is visible
+  bool second_hand;
+  // The cached background includes the hour markings
+  bool hour_dots;
+  uint8_t num_layers;
+  FaceLayer layers[FACE_MAX_LAYERS];
+} Face;
 
 // A structure containing our settings
 typedef struct ClaySettings {
   char SelectClock;
   
+#if defined(PBL_COLOR)
   GColor LeftStripeColor;
   GColor RightStripeColor;
   GColor WatchBandColor;
@@ -16,128 +138,235 @@ typedef struct ClaySettings {
   GColor BatteryColor;
   GColor HandsColor;
   GColor SecondHandColor;
+#endif
   
   bool InvertOutline;
   bool BatteryBarToggle;
   bool StrapDetails;
   bool HourDots; 
+  
+  bool AdaptiveSeconds;
+  uint8_t SecondsTimeout;
+  
+  uint8_t LowBatteryLevel;
+  uint8_t CriticalBatteryLevel;
+  
+  bool NightMode;
+  uint8_t QuietStart;
+  uint8_t QuietEnd;
+  
+  bool SweepSeconds;
+  uint8_t SweepFps;
+  
+  bool StepsComplication;
 } __attribute__((__packed__)) ClaySettings;
 
+// Default colors as GColor8 values. Black and white displays always show
+// these, their config page has no color pickers.
+#define DEFAULT_LeftStripeColor GColorDarkGrayARGB8
+#define DEFAULT_RightStripeColor GColorDarkGrayARGB8
+#define DEFAULT_WatchBandColor GColorWhiteARGB8
+#define DEFAULT_WatchFaceColor GColorWhiteARGB8
+#define DEFAULT_TextColor GColorBlackARGB8
+#define DEFAULT_BatteryColor GColorLightGrayARGB8
+#define DEFAULT_HandsColor GColorBlackARGB8
+#define DEFAULT_SecondHandColor GColorLightGrayARGB8
+
+// A color setting, and whether it differs from the previous settings
+#if defined(PBL_COLOR)
+#define SETTINGS_COLOR(name) (settings.name)
+#define SETTINGS_COLOR_CHANGED(previous, name) (!gcolor_equal(settings.name, (previous)->name))
+#else
+#define SETTINGS_COLOR(name) ((GColor){ .argb = DEFAULT_##name })
+#define SETTINGS_COLOR_CHANGED(previous, name) false
+#endif
+
+// Version byte at the start of every settings message from the phone
+#define SETTINGS_MESSAGE_VERSION 1
+// Settings hash handshake retries on launch
+#define HANDSHAKE_MAX_ATTEMPTS 3
+#define HANDSHAKE_RETRY_MS 1000
+// Sweep second hand frame rate limits, aplite has no time or heap to spare for it
+#define SWEEP_MIN_FPS 5
+#define SWEEP_MAX_FPS 15
+#if !defined(PBL_PLATFORM_APLITE)
+#define SWEEP_SUPPORTED
+#endif
+// Least time between two step count reads, movement updates in between are merged
+#define STEPS_REFRESH_SECONDS 60
+
+// How a settings message byte is stored into ClaySettings
+typedef enum {
+#if defined(PBL_COLOR)
+  SettingsFieldColor,
+#else
+  SettingsFieldFixed,  // a color, always sent as its default
+#endif
+  SettingsFieldBool,
+  SettingsFieldByte
+} SettingsFieldType;
+
+// One entry of the settings message descriptor table
+typedef struct {
+  // Where the byte goes in ClaySettings, or the byte itself for SettingsFieldFixed
+  uint8_t offset;
+  uint8_t type;
+} SettingsField;
+
+// Clock type as stored in flash
+typedef enum {
+  ClockTypeDigital,
+  ClockTypeAnalog
+} ClockType;
+
+// Boolean settings, packed into one flags byte
+enum {
+  SettingsFlagInvertOutline = 1 << 0,
+  SettingsFlagBatteryBar = 1 << 1,
+  SettingsFlagStrapDetails = 1 << 2,
+  SettingsFlagHourDots = 1 << 3,
+  SettingsFlagAdaptiveSeconds = 1 << 4,
+  SettingsFlagNightMode = 1 << 5,
+  SettingsFlagSweepSeconds = 1 << 6,
+  SettingsFlagStepsComplication = 1 << 7
+};
 
+#if defined(PBL_COLOR)
+// Number of colors in the settings, packed 6 bits (rgb) each
+#define NUM_SETTINGS_COLORS 8
+#endif
 
-static void update_time();
+// The settings as they are persisted, always starting with the schema version
+typedef struct PersistedSettings {
+  uint8_t version;
+  uint8_t flags;
+  uint8_t clock;
+#if defined(PBL_COLOR)
+  uint8_t colors[(NUM_SETTINGS_COLORS * 6 + 7) / 8];
+#endif
+  uint8_t seconds_timeout;
+  uint8_t low_battery_level;
+  uint8_t critical_battery_level;
+  uint8_t quiet_start;
+  uint8_t quiet_end;
+  uint8_t sweep_fps;
+} __attribute__((__packed__)) PersistedSettings;
+
+// Layout 1.0 wrote under SETTINGS_KEY, the raw 13-byte ClaySettings
+typedef struct LegacySettings {
+  char SelectClock;
+  GColor LeftStripeColor;
+  GColor RightStripeColor;
+  GColor WatchBandColor;
+  GColor WatchFaceColor;
+  GColor TextColor;
+  GColor BatteryColor;
+  GColor HandsColor;
+  GColor SecondHandColor;
+  bool InvertOutline;
+  bool BatteryBarToggle;
+  bool StrapDetails;
+  bool HourDots;
+} __attribute__((__packed__)) LegacySettings;
+
+
+
+static void update_time_state(struct tm *t, TimeUnits units_changed);
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed);
+static void refresh_time(TimeUnits units);
+static void show_time_text(struct tm *t);
+static void show_date_text(struct tm *t);
+static void redraw_hands(struct tm *t);
+static void redraw_second_hand(struct tm *t);
 static void battery_callback(BatteryChargeState state);
+static PowerProfile battery_power_profile();
+static void update_power_profile();
+static bool seconds_shown();
+static bool night_time(struct tm *t);
+static void update_night_mode(struct tm *t);
+#if defined(PBL_HEALTH)
+static void health_handler(HealthEventType event, void *context);
+#endif
 static void battery_update_proc(Layer *layer, GContext *ctx);
+#if defined(PBL_HEALTH)
+static void refresh_steps();
+static void steps_timer_callback(void *data);
+static void schedule_steps_refresh();
+static void steps_update_proc(Layer *layer, GContext *ctx);
+#endif
+static void emit_op(DrawOpType type, uint8_t value, GPoint a, GPoint b);
+static void emit_state(DrawOpType type, uint8_t value);
+static void build_background_list();
+static void draw_background(GContext *ctx);
+static void invalidate_background();
+static void cache_background(GContext *ctx, GRect bounds);
 static void canvas_update_proc(Layer *layer, GContext *ctx);
+static GPoint hand_point(GPoint center, HandOffset offset);
 static void hands_update_proc(Layer *layer, GContext *ctx);
-static void handle_second_tick(struct tm *tick_time, TimeUnits units_changed);
+static void second_update_proc(Layer *layer, GContext *ctx);
+static void seconds_timeout_callback(void *data);
+static void start_seconds_burst();
+static void accel_tap_handler(AccelAxisType axis, int32_t direction);
+static void configure_seconds_mode();
+static void start_sweep();
+static void stop_sweep();
+#if defined(SWEEP_SUPPORTED)
+static uint32_t milliseconds_now();
+static uint16_t milliseconds_into_minute();
+static void sweep_timer_callback(void *data);
+static void app_focus_handler(bool in_focus);
+#endif
 static void default_settings();
+#if defined(PBL_COLOR)
+static GColor *settings_color(int index);
+static void pack_color(uint8_t *packed, int index, GColor color);
+static GColor unpack_color(const uint8_t *packed, int index);
+#endif
+static void encode_settings(PersistedSettings *persisted);
+static bool decode_settings(const PersistedSettings *persisted, int size);
+static bool migrate_legacy_settings();
 static void load_settings();
 static void save_settings();
-static void update_display();
+static void apply_settings(const ClaySettings *previous);
+static void subscribe_tick_timer();
+static void create_battery_layer();
+static void destroy_battery_layer();
+static void create_steps_layer();
+static void destroy_steps_layer();
+#if defined(DIGIT_ATLAS)
+static void recolor_digits();
+static void set_digits(const char *text);
+static void digits_update_proc(Layer *layer, GContext *ctx);
+static void load_digit_atlas();
+static void unload_digit_atlas();
+#endif
+static const Face *face_for(char clock);
+static void create_face_layers(Layer *window_layer);
+static void destroy_face_layers();
+static bool decode_settings_message(const uint8_t *data, uint16_t length);
+static void encode_settings_message(uint8_t *data);
+static uint32_t settings_hash(const uint8_t *data, uint16_t length);
+static void update_settings_hash();
+static void send_settings_hash();
+static void handshake_retry_callback(void *data);
+static void outbox_failed_handler(DictionaryIterator *iter, AppMessageResult reason, void *context);
 static void inbox_received_handler(DictionaryIterator *iter, void *context);
 static void window_load(Window *window);
 static void window_unload(Window *window);
+#if defined(RENDER_STATS)
+static uint32_t frame_pixels();
+#endif
+#if defined(RENDER_STATS) && !defined(SETTINGS_SOAK)
+static void start_simulation();
+static void simulate_day(void *data);
+static void end_simulation();
+#endif
+#if defined(SETTINGS_SOAK)
+static void soak_message(const uint8_t *data, uint16_t length);
+static void soak_window();
+static void soak_report(void *data);
+static void soak_settings(void *data);
+#endif
+static void finish_startup(void *data);
 static void init(void);
 static void deinit(void);
-
-
-
-static const struct GPathInfo ANALOG_BG_POINTS[] = {
-  { 4, (GPoint []) {
-      {68, 0},
-      {71, 0},
-      {71, 12},
-      {68, 12}
-    }
-  },
-  { 4, (GPoint []) {
-      {72, 0},
-      {75, 0},
-      {75, 12},
-      {72, 12}
-    }
-  },
-  { 4, (GPoint []) {
-      {112, 10},
-      {114, 12},
-      {108, 23},
-      {106, 21}
-    }
-  },
-  { 4, (GPoint []) {
-      {132, 47},
-      {144, 40},
-      {144, 44},
-      {135, 49}
-    }
-  },
-  { 4, (GPoint []) {
-      {135, 118},
-      {144, 123},
-      {144, 126},
-      {132, 120}
-    }
-  },
-  { 4, (GPoint []) {
-      {108, 144},
-      {114, 154},
-      {112, 157},
-      {106, 147}
-    }
-  },
-  { 4, (GPoint []) {
-      {70, 155},
-      {73, 155},
-      {73, 167},
-      {70, 167}
-    }
-  },
-  { 4, (GPoint []) {
-      {32, 10},
-      {30, 12},
-      {36, 23},
-      {38, 21}
-    }
-  },
-  { 4, (GPoint []) {
-      {12, 47},
-      {-1, 40},
-      {-1, 44},
-      {9, 49}
-    }
-  },
-  { 4, (GPoint []) {
-      {9, 118},
-      {-1, 123},
-      {-1, 126},
-      {12, 120}
-    }
-  },
-  { 4, (GPoint []) {
-      {36, 144},
-      {30, 154},
-      {32, 157},
-      {38, 147}
-    }
-  }
-};
-
-
-
-static const GPathInfo MINUTE_HAND_POINTS = {
-  2, (GPoint []) {
-    { 0, 0},
-    { 0, -45}
-  }
-};
-
-
-
-static const GPathInfo HOUR_HAND_POINTS = {
-  2, (GPoint []) {
-    { 0, 0},
-    { 0, -27}
-  }
-};
\ No newline at end of file
@@ -0,0 +1,491 @@
+#include <pebble.h>
+#include "render_stats.h"
+
+#if defined(RENDER_STATS)
+
+// Running totals for one update proc since the last report
+typedef struct {
+  uint32_t calls;
+  uint32_t ops;
+  uint32_t state_changes;
+  uint32_t elapsed_ms;
+  int32_t heap_delta;
+  uint32_t painted;
+  // Pixels inside the proc's layer that differ from the previous frame
+  uint32_t changed;
+} ProcStats;
+
+static const char *const PROC_NAMES[RenderProcCount] = {
+  "canvas",
+  "battery",
+  "hands",
+  "second",
+  "digits",
+  "steps",
+};
+
+#if defined(PBL_PLATFORM_APLITE)
+static const char *const PLATFORM_NAME = "aplite";
+#elif defined(PBL_PLATFORM_BASALT)
+static const char *const PLATFORM_NAME = "basalt";
+#elif defined(PBL_PLATFORM_CHALK)
+static const char *const PLATFORM_NAME = "chalk";
+#elif defined(PBL_PLATFORM_DIORITE)
+static const char *const PLATFORM_NAME = "diorite";
+#elif defined(PBL_PLATFORM_EMERY)
+static const char *const PLATFORM_NAME = "emery";
+#else
+static const char *const PLATFORM_NAME = "unknown";
+#endif
+
+// Totals for the simulated day
+typedef struct {
+  uint32_t wakeups;
+  uint32_t invalidations;
+  uint32_t frames;
+  uint64_t pixels;
+  uint32_t flash_writes;
+} DayStats;
+
+// Framebuffer diffs since the last report
+typedef struct {
+  uint32_t frames;
+  uint32_t changed;
+  uint32_t painted;
+  uint32_t elapsed_ms;
+  uint32_t hash;
+} DiffStats;
+
+// Last draw times of every proc in milliseconds, oldest overwritten first
+typedef struct {
+  uint16_t samples[RENDER_STATS_RING_SIZE];
+  uint8_t next;
+  uint8_t count;
+} DurationRing;
+
+static ProcStats s_procs[RenderProcCount];
+static DurationRing s_durations[RenderProcCount];
+// Most heap the face has used at any measured point
+static size_t s_peak_heap;
+
+static const char *const OBJECT_NAMES[RenderObjectCount] = {
+  "layers",
+  "text_layers",
+  "fonts",
+  "bitmaps",
+};
+
+// Live heap objects, and what was live when the soak started
+static int32_t s_objects[RenderObjectCount];
+static int32_t s_soak_objects[RenderObjectCount];
+static size_t s_soak_heap;
+// Set once any count went below zero, an object destroyed twice
+static bool s_soak_overfreed;
+static DiffStats s_diff;
+static DayStats s_day;
+// Invalidations when the current wakeup started
+static uint32_t s_wakeup_invalidations;
+static char s_clock = '?';
+
+// The proc currently drawing, and what it started with
+static int s_active = -1;
+static uint32_t s_start_ms;
+static size_t s_start_heap;
+
+// Topmost layer that compares every finished frame with the one before
+static Layer *s_probe_layer;
+static uint32_t (*s_frame_pixels)(void);
+static uint8_t *s_previous_frame;
+// When the background, the first layer of every frame, started drawing
+static uint32_t s_frame_start_ms;
+// Procs that drew in the current frame, and where in the window
+static uint8_t s_frame_procs;
+static GRect s_frame_rects[RenderProcCount];
+// When init started, until the first frame has been reported
+static bool s_launching;
+static uint32_t s_launch_ms;
+
+
+
+// Milliseconds since the epoch, wrapping is fine for short differences
+static uint32_t now_ms() {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return (uint32_t)seconds * 1000 + millis;
+}
+
+
+
+// Log per-frame averages for every proc and start counting again
+static void report() {
+  uint32_t frames = s_procs[RenderProcCanvas].calls;
+  APP_LOG(APP_LOG_LEVEL_INFO, "render %s clock=%c frames=%lu", PLATFORM_NAME, s_clock,
+          (unsigned long)frames);
+  for (int i = 0; i < RenderProcCount; ++i) {
+    ProcStats *stats = &s_procs[i];
+    if (stats->calls == 0) {
+      continue;
+    }
+    // Tenths of an op and microseconds, averaged per call
+    APP_LOG(APP_LOG_LEVEL_INFO, "  %s calls=%lu ops/frame=%lu.%lu state/frame=%lu.%lu us/frame=%lu heap=%ld painted/frame=%lu changed/frame=%lu wasted=%lu%%",
+            PROC_NAMES[i], (unsigned long)stats->calls,
+            (unsigned long)(stats->ops * 10 / stats->calls / 10),
+            (unsigned long)(stats->ops * 10 / stats->calls % 10),
+            (unsigned long)(stats->state_changes * 10 / stats->calls / 10),
+            (unsigned long)(stats->state_changes * 10 / stats->calls % 10),
+            (unsigned long)(stats->elapsed_ms * 1000 / stats->calls),
+            (long)stats->heap_delta,
+            (unsigned long)(stats->painted / stats->calls),
+            (unsigned long)(stats->changed / stats->calls),
+            (unsigned long)(stats->painted ? 100 - (uint64_t)stats->changed * 100 / stats->painted : 0));
+  }
+  memset(s_procs, 0, sizeof(s_procs));
+
+  // Draw time spread over the last frames of each proc
+  for (int i = 0; i < RenderProcCount; ++i) {
+    DurationRing *ring = &s_durations[i];
+    if (ring->count == 0) {
+      continue;
+    }
+    uint32_t total = 0;
+    uint16_t min = UINT16_MAX;
+    uint16_t max = 0;
+    for (int j = 0; j < ring->count; ++j) {
+      uint16_t sample = ring->samples[j];
+      total += sample;
+      min = sample < min ? sample : min;
+      max = sample > max ? sample : max;
+    }
+    APP_LOG(APP_LOG_LEVEL_INFO, "  %s ms min=%u avg=%lu.%lu max=%u samples=%u",
+            PROC_NAMES[i], min,
+            (unsigned long)(total * 10 / ring->count / 10),
+            (unsigned long)(total * 10 / ring->count % 10),
+            max, ring->count);
+  }
+
+  // Pixels that really changed against everything the layers repainted
+  if (s_diff.frames > 0 && s_diff.painted > 0) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "  diff frames=%lu ms/frame=%lu changed/frame=%lu painted/frame=%lu wasted=%lu%% hash=%08lx",
+            (unsigned long)s_diff.frames,
+            (unsigned long)(s_diff.elapsed_ms / s_diff.frames),
+            (unsigned long)(s_diff.changed / s_diff.frames),
+            (unsigned long)(s_diff.painted / s_diff.frames),
+            (unsigned long)(100 - (uint64_t)s_diff.changed * 100 / s_diff.painted),
+            (unsigned long)s_diff.hash);
+  }
+  memset(&s_diff, 0, sizeof(s_diff));
+}
+
+
+
+// Credit a changed pixel to every proc that drew over it in this frame
+static void count_changed(int16_t x, int16_t y) {
+  GPoint point = GPoint(x, y);
+  for (int i = 0; i < RenderProcCount; ++i) {
+    if ((s_frame_procs & (1 << i)) && grect_contains_point(&s_frame_rects[i], &point)) {
+      s_procs[i].changed++;
+    }
+  }
+}
+
+
+
+// Compare the finished frame with the previous one and keep a copy of it.
+// Color framebuffers are 8 bits per pixel, black and white ones 1 bit.
+static void probe_update_proc(Layer *layer, GContext *ctx) {
+  // Every layer of the frame, including the TextLayers, has drawn by now
+  uint32_t elapsed_ms = now_ms() - s_frame_start_ms;
+  if (s_launching) {
+    s_launching = false;
+    APP_LOG(APP_LOG_LEVEL_INFO, "launch %s first frame %lu ms", PLATFORM_NAME,
+            (unsigned long)(now_ms() - s_launch_ms));
+  }
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if (!frame_buffer) {
+    return;
+  }
+  GRect bounds = gbitmap_get_bounds(frame_buffer);
+#if defined(PBL_BW)
+  uint16_t row_bytes = gbitmap_get_bytes_per_row(frame_buffer);
+#else
+  uint16_t row_bytes = bounds.size.w;
+#endif
+  bool first = !s_previous_frame;
+  if (first) {
+    s_previous_frame = malloc(row_bytes * bounds.size.h);
+    if (!s_previous_frame) {
+      graphics_release_frame_buffer(ctx, frame_buffer);
+      return;
+    }
+  }
+
+  // FNV-1a over the visible pixels tells identical frames apart in the log
+  uint32_t hash = 2166136261u;
+  uint32_t changed = 0;
+  for (int y = 0; y < bounds.size.h; ++y) {
+    uint8_t *previous = s_previous_frame + y * row_bytes;
+#if defined(PBL_BW)
+    uint8_t *row = gbitmap_get_data(frame_buffer) + y * row_bytes;
+    int min_x = 0;
+    int max_x = (bounds.size.w + 7) / 8 - 1;
+#else
+    // Round displays only store the visible span of each row
+    GBitmapDataRowInfo info = gbitmap_get_data_row_info(frame_buffer, y);
+    uint8_t *row = info.data;
+    int min_x = info.min_x;
+    int max_x = info.max_x;
+#endif
+    for (int x = min_x; x <= max_x; ++x) {
+      hash = (hash ^ row[x]) * 16777619u;
+#if defined(PBL_BW)
+      // Pixel x * 8 + n is bit n of the byte
+      for (uint8_t bits = row[x] ^ previous[x]; bits; bits &= bits - 1) {
+        changed++;
+        if (!first) {
+          count_changed(x * 8 + __builtin_ctz(bits), y);
+        }
+      }
+#else
+      if (row[x] != previous[x]) {
+        changed++;
+        if (!first) {
+          count_changed(x, y);
+        }
+      }
+#endif
+      previous[x] = row[x];
+    }
+  }
+  graphics_release_frame_buffer(ctx, frame_buffer);
+
+  // The first frame has nothing to compare against
+  if (!first) {
+    s_diff.frames++;
+    s_diff.elapsed_ms += elapsed_ms;
+    s_diff.changed += changed;
+    s_diff.painted += s_frame_pixels();
+  }
+  s_diff.hash = hash;
+}
+
+
+
+void render_stats_begin(RenderProc proc, Layer *layer) {
+  GRect bounds = layer_get_bounds(layer);
+  s_procs[proc].painted += bounds.size.w * bounds.size.h;
+  s_active = proc;
+  s_start_heap = heap_bytes_used();
+  s_start_ms = now_ms();
+  if (proc == RenderProcCanvas) {
+    s_frame_start_ms = s_start_ms;
+    s_frame_procs = 0;
+  }
+  // Every measured layer is a child of the window's root layer
+  s_frame_rects[proc] = layer_get_frame(layer);
+  s_frame_procs |= 1 << proc;
+}
+
+
+
+void render_stats_end(RenderProc proc) {
+  ProcStats *stats = &s_procs[proc];
+  uint32_t elapsed_ms = now_ms() - s_start_ms;
+  size_t heap = heap_bytes_used();
+  stats->elapsed_ms += elapsed_ms;
+  stats->heap_delta += (int32_t)heap - (int32_t)s_start_heap;
+  stats->calls++;
+  s_peak_heap = heap > s_peak_heap ? heap : s_peak_heap;
+
+  DurationRing *ring = &s_durations[proc];
+  ring->samples[ring->next] = elapsed_ms > UINT16_MAX ? UINT16_MAX : elapsed_ms;
+  ring->next = (ring->next + 1) % RENDER_STATS_RING_SIZE;
+  if (ring->count < RENDER_STATS_RING_SIZE) {
+    ring->count++;
+  }
+  s_active = -1;
+
+  // The background is drawn once per frame, so it paces the reports
+  if (proc == RenderProcCanvas && stats->calls >= RENDER_STATS_REPORT_FRAMES) {
+    report();
+  }
+}
+
+
+
+void render_stats_op(void) {
+  if (s_active >= 0) {
+    s_procs[s_active].ops++;
+  }
+}
+
+
+
+void render_stats_state(void) {
+  if (s_active >= 0) {
+    s_procs[s_active].state_changes++;
+  }
+}
+
+
+
+void render_stats_day_begin(void) {
+  memset(&s_day, 0, sizeof(s_day));
+}
+
+
+
+void render_stats_wakeup(void) {
+  s_day.wakeups++;
+  s_wakeup_invalidations = s_day.invalidations;
+}
+
+
+
+void render_stats_wakeup_end(uint32_t frame_pixels) {
+  // Any invalidation during the wakeup means one redraw of the whole window
+  if (s_day.invalidations != s_wakeup_invalidations) {
+    s_day.frames++;
+    s_day.pixels += frame_pixels;
+  }
+}
+
+
+
+void render_stats_invalidate(void) {
+  s_day.invalidations++;
+}
+
+
+
+void render_stats_flash_write(void) {
+  s_day.flash_writes++;
+}
+
+
+
+void render_stats_day_report(const char *config) {
+  uint32_t kilopixels = (uint32_t)(s_day.pixels / 1000);
+  uint32_t energy = s_day.wakeups * ENERGY_PER_WAKEUP +
+                    s_day.invalidations * ENERGY_PER_INVALIDATION +
+                    kilopixels * ENERGY_PER_KILOPIXEL +
+                    s_day.flash_writes * ENERGY_PER_FLASH_WRITE;
+  APP_LOG(APP_LOG_LEVEL_INFO, "day %s %s", PLATFORM_NAME, config);
+  APP_LOG(APP_LOG_LEVEL_INFO, "  wakeups=%lu invalidations=%lu frames=%lu kpixels=%lu flash=%lu energy=%lu",
+          (unsigned long)s_day.wakeups, (unsigned long)s_day.invalidations,
+          (unsigned long)s_day.frames, (unsigned long)kilopixels,
+          (unsigned long)s_day.flash_writes, (unsigned long)energy);
+}
+
+
+
+void render_stats_set_mode(char clock) {
+  // Numbers from different clock modes are not comparable
+  if (clock != s_clock) {
+    memset(s_procs, 0, sizeof(s_procs));
+    memset(&s_diff, 0, sizeof(s_diff));
+    memset(s_durations, 0, sizeof(s_durations));
+    s_clock = clock;
+  }
+}
+
+
+
+void render_stats_attach(Layer *window_layer, uint32_t (*frame_pixels)(void)) {
+  s_frame_pixels = frame_pixels;
+  if (!s_probe_layer) {
+    s_probe_layer = layer_create(layer_get_bounds(window_layer));
+    layer_set_update_proc(s_probe_layer, probe_update_proc);
+  } else {
+    layer_remove_from_parent(s_probe_layer);
+  }
+  // Children draw in the order they were added, so the probe goes last
+  layer_add_child(window_layer, s_probe_layer);
+}
+
+
+
+void render_stats_detach(void) {
+  if (s_probe_layer) {
+    layer_destroy(s_probe_layer);
+    s_probe_layer = NULL;
+  }
+  free(s_previous_frame);
+  s_previous_frame = NULL;
+}
+
+
+
+void render_stats_launch(void) {
+  s_launching = true;
+  s_launch_ms = now_ms();
+}
+
+
+
+void render_stats_started(void) {
+  APP_LOG(APP_LOG_LEVEL_INFO, "launch %s deferred startup done %lu ms", PLATFORM_NAME,
+          (unsigned long)(now_ms() - s_launch_ms));
+}
+
+
+
+void render_stats_heap(const char *event) {
+  size_t used = heap_bytes_used();
+  s_peak_heap = used > s_peak_heap ? used : s_peak_heap;
+  APP_LOG(APP_LOG_LEVEL_INFO, "heap %s %s used=%lu free=%lu peak=%lu", PLATFORM_NAME, event,
+          (unsigned long)used, (unsigned long)heap_bytes_free(),
+          (unsigned long)s_peak_heap);
+}
+
+
+
+
+void *render_stats_created(RenderObject object, void *pointer) {
+  if (pointer) {
+    s_objects[object]++;
+  }
+  size_t used = heap_bytes_used();
+  s_peak_heap = used > s_peak_heap ? used : s_peak_heap;
+  return pointer;
+}
+
+
+
+void *render_stats_destroyed(RenderObject object, void *pointer) {
+  if (pointer && --s_objects[object] < 0) {
+    s_soak_overfreed = true;
+    APP_LOG(APP_LOG_LEVEL_ERROR, "soak destroyed more %s than were created", OBJECT_NAMES[object]);
+  }
+  return pointer;
+}
+
+
+
+void render_stats_soak_begin(void) {
+  memcpy(s_soak_objects, s_objects, sizeof(s_objects));
+  s_soak_heap = heap_bytes_used();
+  s_peak_heap = s_soak_heap;
+}
+
+
+
+void render_stats_soak_report(uint32_t messages) {
+  // Back on the starting settings, so everything should be as it was
+  size_t heap = heap_bytes_used();
+  bool passed = heap <= s_soak_heap + SOAK_HEAP_SLACK && !s_soak_overfreed;
+  APP_LOG(APP_LOG_LEVEL_INFO, "soak %s messages=%lu heap start=%lu end=%lu slack=%lu peak=%lu aplite budget=%lu%%",
+          PLATFORM_NAME, (unsigned long)messages, (unsigned long)s_soak_heap,
+          (unsigned long)heap, (unsigned long)SOAK_HEAP_SLACK, (unsigned long)s_peak_heap,
+          (unsigned long)(s_peak_heap * 100 / APLITE_HEAP_BUDGET));
+  for (int i = 0; i < RenderObjectCount; ++i) {
+    if (s_objects[i] != s_soak_objects[i]) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "  leaked %s=%ld", OBJECT_NAMES[i],
+              (long)(s_objects[i] - s_soak_objects[i]));
+      passed = false;
+    }
+  }
+  APP_LOG(passed ? APP_LOG_LEVEL_INFO : APP_LOG_LEVEL_ERROR, "soak %s", passed ? "passed" : "FAILED");
+}
+
+#endif
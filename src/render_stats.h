@@ -0,0 +1,141 @@
+#include <pebble.h>
+#pragma once
+
+// Debug-only render statistics, built with RENDER_STATS=1 pebble build
+// and read with pebble logs. Compiles to nothing otherwise.
+
+// Number of frames between reports
+#define RENDER_STATS_REPORT_FRAMES 60
+// Recent draw times kept per update proc for min/avg/max
+#define RENDER_STATS_RING_SIZE 32
+
+// Simulated day, run on launch and after every settings change
+#define SIM_START_DELAY_MS 2000
+#define SIM_DAY_SECONDS (24 * 60 * 60)
+// Simulated seconds run per timer callback, and the wait between callbacks
+#define SIM_BATCH_SECONDS (15 * 60)
+#define SIM_BATCH_INTERVAL_MS 50
+// Battery falls 10% every 2.4 hours, from 100% at midnight to 10%
+#define SIM_BATTERY_STEP_SECONDS (SIM_DAY_SECONDS / 10)
+// One wrist flick every 15 minutes for the adaptive second hand
+#define SIM_FLICK_INTERVAL_SECONDS (15 * 60)
+// One settings save from the phone at noon, counted but not written
+#define SIM_SETTINGS_SAVE_SECOND (12 * 60 * 60)
+
+// Energy cost model for the simulated day, in arbitrary units
+#define ENERGY_PER_WAKEUP 100
+#define ENERGY_PER_INVALIDATION 5
+#define ENERGY_PER_KILOPIXEL 20
+#define ENERGY_PER_FLASH_WRITE 2000
+
+// Settings soak, built with SETTINGS_SOAK=1 on the emulator (it saves every message)
+#define SOAK_MESSAGES 2000
+#define SOAK_BATCH 20
+#define SOAK_INTERVAL_MS 100
+// Cycle the window through unload and load every this many messages
+#define SOAK_WINDOW_INTERVAL 200
+// How far above its start the heap may end, for allocator padding and fragmentation
+#define SOAK_HEAP_SLACK 256
+// Heap available to apps on aplite, the smallest platform
+#define APLITE_HEAP_BUDGET 24576
+
+// Heap objects we count, created and destroyed in the including file
+typedef enum {
+  RenderObjectLayer,
+  RenderObjectTextLayer,
+  RenderObjectFont,
+  RenderObjectBitmap,
+  RenderObjectCount
+} RenderObject;
+
+// Update procs we measure
+typedef enum {
+  RenderProcCanvas,
+  RenderProcBattery,
+  RenderProcHands,
+  RenderProcSecond,
+  RenderProcDigits,
+  RenderProcSteps,
+  RenderProcCount
+} RenderProc;
+
+#if defined(RENDER_STATS)
+
+void render_stats_begin(RenderProc proc, Layer *layer);
+void render_stats_end(RenderProc proc);
+void render_stats_op(void);
+void render_stats_state(void);
+void render_stats_set_mode(char clock);
+void render_stats_day_begin(void);
+void render_stats_wakeup(void);
+void render_stats_wakeup_end(uint32_t frame_pixels);
+void render_stats_invalidate(void);
+void render_stats_flash_write(void);
+void render_stats_day_report(const char *config);
+void render_stats_attach(Layer *window_layer, uint32_t (*frame_pixels)(void));
+void render_stats_detach(void);
+void render_stats_launch(void);
+void render_stats_started(void);
+void render_stats_heap(const char *event);
+void *render_stats_created(RenderObject object, void *pointer);
+void *render_stats_destroyed(RenderObject object, void *pointer);
+void render_stats_soak_begin(void);
+void render_stats_soak_report(uint32_t messages);
+
+#define RENDER_STATS_BEGIN(proc, layer) render_stats_begin(proc, layer)
+#define RENDER_STATS_END(proc) render_stats_end(proc)
+#define RENDER_STATS_MODE(clock) render_stats_set_mode(clock)
+#define RENDER_STATS_ATTACH(window_layer, frame_pixels) render_stats_attach(window_layer, frame_pixels)
+#define RENDER_STATS_DETACH() render_stats_detach()
+#define RENDER_STATS_HEAP(event) render_stats_heap(event)
+#define RENDER_STATS_LAUNCH() render_stats_launch()
+#define RENDER_STATS_STARTED() render_stats_started()
+
+// Count every drawing primitive and context state change in the including file
+#define graphics_fill_rect(...) (render_stats_op(), graphics_fill_rect(__VA_ARGS__))
+#define graphics_draw_line(...) (render_stats_op(), graphics_draw_line(__VA_ARGS__))
+#define graphics_draw_circle(...) (render_stats_op(), graphics_draw_circle(__VA_ARGS__))
+#define graphics_fill_circle(...) (render_stats_op(), graphics_fill_circle(__VA_ARGS__))
+#define graphics_draw_arc(...) (render_stats_op(), graphics_draw_arc(__VA_ARGS__))
+#define graphics_draw_bitmap_in_rect(...) (render_stats_op(), graphics_draw_bitmap_in_rect(__VA_ARGS__))
+#define graphics_draw_text(...) (render_stats_op(), graphics_draw_text(__VA_ARGS__))
+#define gpath_draw_filled(...) (render_stats_op(), gpath_draw_filled(__VA_ARGS__))
+#define gpath_draw_outline(...) (render_stats_op(), gpath_draw_outline(__VA_ARGS__))
+#define graphics_context_set_fill_color(...) (render_stats_state(), graphics_context_set_fill_color(__VA_ARGS__))
+#define graphics_context_set_stroke_color(...) (render_stats_state(), graphics_context_set_stroke_color(__VA_ARGS__))
+#define graphics_context_set_stroke_width(...) (render_stats_state(), graphics_context_set_stroke_width(__VA_ARGS__))
+#define graphics_context_set_text_color(...) (render_stats_state(), graphics_context_set_text_color(__VA_ARGS__))
+#define graphics_context_set_antialiased(...) (render_stats_state(), graphics_context_set_antialiased(__VA_ARGS__))
+#define graphics_context_set_compositing_mode(...) (render_stats_state(), graphics_context_set_compositing_mode(__VA_ARGS__))
+
+// Count invalidations and flash writes for the simulated day
+#define layer_mark_dirty(...) (render_stats_invalidate(), layer_mark_dirty(__VA_ARGS__))
+#define layer_set_hidden(...) (render_stats_invalidate(), layer_set_hidden(__VA_ARGS__))
+#define text_layer_set_text(...) (render_stats_invalidate(), text_layer_set_text(__VA_ARGS__))
+#define persist_write_data(...) (render_stats_flash_write(), persist_write_data(__VA_ARGS__))
+
+// Count live layers, fonts and bitmaps for the settings soak
+#define layer_create(...) ((Layer *)render_stats_created(RenderObjectLayer, layer_create(__VA_ARGS__)))
+#define layer_destroy(layer) layer_destroy(render_stats_destroyed(RenderObjectLayer, layer))
+#define text_layer_create(...) ((TextLayer *)render_stats_created(RenderObjectTextLayer, text_layer_create(__VA_ARGS__)))
+#define text_layer_destroy(layer) text_layer_destroy(render_stats_destroyed(RenderObjectTextLayer, layer))
+#define fonts_load_custom_font(...) ((GFont)render_stats_created(RenderObjectFont, fonts_load_custom_font(__VA_ARGS__)))
+#define fonts_unload_custom_font(font) fonts_unload_custom_font(render_stats_destroyed(RenderObjectFont, font))
+#define gbitmap_create_blank(...) ((GBitmap *)render_stats_created(RenderObjectBitmap, gbitmap_create_blank(__VA_ARGS__)))
+#define gbitmap_create_blank_with_palette(...) ((GBitmap *)render_stats_created(RenderObjectBitmap, gbitmap_create_blank_with_palette(__VA_ARGS__)))
+#define gbitmap_create_with_resource(...) ((GBitmap *)render_stats_created(RenderObjectBitmap, gbitmap_create_with_resource(__VA_ARGS__)))
+#define gbitmap_create_as_sub_bitmap(...) ((GBitmap *)render_stats_created(RenderObjectBitmap, gbitmap_create_as_sub_bitmap(__VA_ARGS__)))
+#define gbitmap_destroy(bitmap) gbitmap_destroy(render_stats_destroyed(RenderObjectBitmap, bitmap))
+
+#else
+
+#define RENDER_STATS_BEGIN(proc, layer)
+#define RENDER_STATS_END(proc)
+#define RENDER_STATS_MODE(clock)
+#define RENDER_STATS_ATTACH(window_layer, frame_pixels)
+#define RENDER_STATS_DETACH()
+#define RENDER_STATS_HEAP(event)
+#define RENDER_STATS_LAUNCH()
+#define RENDER_STATS_STARTED()
+
+#endif
@@ -0,0 +1,219 @@
+#!/usr/bin/env python
+#
+# Renders the digits and colon of the time font into a 1-bit sprite strip,
+# resources/images/digit_atlas.png, for the DIGIT_ATLAS renderer in main.c.
+# Only needs the standard library, run it again if the time font changes:
+#
+#   python tools/digit_atlas.py
+#
+# Prints the cell layout to copy into the DIGIT_ATLAS_* defines in main.h.
+
+import os.path
+import struct
+import zlib
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+FONT = os.path.join(ROOT, 'resources', 'fonts', 'NotoSans-Bold36.ttf')
+OUTPUT = os.path.join(ROOT, 'resources', 'images', 'digit_atlas.png')
+# Same pixel size the font resource is built with
+PIXEL_SIZE = 36
+CHARACTERS = '0123456789:'
+# Samples per pixel along each axis, a pixel is ink when half are covered
+SUPERSAMPLE = 4
+
+
+def tables(data):
+    count = struct.unpack('>H', data[4:6])[0]
+    result = {}
+    for i in range(count):
+        tag, _, offset, length = struct.unpack('>4sIII', data[12 + 16 * i:28 + 16 * i])
+        result[tag.decode('ascii')] = data[offset:offset + length]
+    return result
+
+
+def glyph_index(cmap, char):
+    # Unicode BMP subtable, format 4
+    count = struct.unpack('>H', cmap[2:4])[0]
+    for i in range(count):
+        platform, encoding, offset = struct.unpack('>HHI', cmap[4 + 8 * i:12 + 8 * i])
+        if (platform, encoding) in ((3, 1), (0, 3)) and struct.unpack('>H', cmap[offset:offset + 2])[0] == 4:
+            table = cmap[offset:]
+            segments = struct.unpack('>H', table[6:8])[0] // 2
+            def array(start):
+                return struct.unpack('>%dH' % segments, table[start:start + 2 * segments])
+            ends = array(14)
+            starts = array(16 + 2 * segments)
+            deltas = array(16 + 4 * segments)
+            range_offsets_at = 16 + 6 * segments
+            range_offsets = array(range_offsets_at)
+            code = ord(char)
+            for s in range(segments):
+                if starts[s] <= code <= ends[s]:
+                    if range_offsets[s] == 0:
+                        return (code + deltas[s]) & 0xFFFF
+                    at = range_offsets_at + 2 * s + range_offsets[s] + 2 * (code - starts[s])
+                    index = struct.unpack('>H', table[at:at + 2])[0]
+                    return (index + deltas[s]) & 0xFFFF if index else 0
+    raise ValueError('no unicode cmap for %r' % char)
+
+
+def glyph_contours(glyf, loca, long_loca, index):
+    if long_loca:
+        start, end = struct.unpack('>II', loca[4 * index:4 * index + 8])
+    else:
+        start, end = [2 * x for x in struct.unpack('>HH', loca[2 * index:2 * index + 4])]
+    data = glyf[start:end]
+    if not data:
+        return []
+    contour_count = struct.unpack('>h', data[0:2])[0]
+    if contour_count < 0:
+        raise ValueError('composite glyphs are not supported')
+    ends = struct.unpack('>%dH' % contour_count, data[10:10 + 2 * contour_count])
+    at = 10 + 2 * contour_count
+    instructions = struct.unpack('>H', data[at:at + 2])[0]
+    at += 2 + instructions
+    points = ends[-1] + 1
+
+    flags = []
+    while len(flags) < points:
+        flag = ord(data[at:at + 1])
+        at += 1
+        flags.append(flag)
+        if flag & 8:
+            repeat = ord(data[at:at + 1])
+            at += 1
+            flags.extend([flag] * repeat)
+
+    def coordinates(short_bit, same_bit):
+        values = []
+        value = 0
+        for flag in flags:
+            if flag & short_bit:
+                delta = ord(data[at_ref[0]:at_ref[0] + 1])
+                at_ref[0] += 1
+                value += delta if flag & same_bit else -delta
+            elif not flag & same_bit:
+                value += struct.unpack('>h', data[at_ref[0]:at_ref[0] + 2])[0]
+                at_ref[0] += 2
+            values.append(value)
+        return values
+
+    at_ref = [at]
+    xs = coordinates(2, 16)
+    ys = coordinates(4, 32)
+
+    contours = []
+    first = 0
+    for last in ends:
+        contours.append([(xs[i], ys[i], flags[i] & 1) for i in range(first, last + 1)])
+        first = last + 1
+    return contours
+
+
+def flatten(contour, steps=8):
+    # Expand the implied on-curve points, then walk the quadratic segments
+    points = []
+    for i, (x, y, on) in enumerate(contour):
+        px, py, pon = contour[i - 1]
+        if not on and not pon:
+            points.append(((x + px) / 2.0, (y + py) / 2.0, 1))
+        points.append((x, y, on))
+    start = next(i for i, p in enumerate(points) if p[2])
+    points = points[start:] + points[:start]
+    points.append(points[0])
+
+    polygon = [points[0][:2]]
+    i = 1
+    while i < len(points):
+        x, y, on = points[i]
+        if on:
+            polygon.append((x, y))
+            i += 1
+        else:
+            x0, y0 = polygon[-1]
+            x2, y2 = points[i + 1][:2]
+            for step in range(1, steps + 1):
+                t = step / float(steps)
+                polygon.append(((1 - t) ** 2 * x0 + 2 * (1 - t) * t * x + t * t * x2,
+                                (1 - t) ** 2 * y0 + 2 * (1 - t) * t * y + t * t * y2))
+            i += 2
+    return polygon
+
+
+def covered(polygons, x, y):
+    # Nonzero winding rule
+    winding = 0
+    for polygon in polygons:
+        for (x0, y0), (x1, y1) in zip(polygon, polygon[1:]):
+            if (y0 <= y) != (y1 <= y):
+                cross = x0 + (y - y0) * (x1 - x0) / (y1 - y0)
+                if cross > x:
+                    winding += 1 if y1 > y0 else -1
+    return winding != 0
+
+
+def png(path, width, height, rows):
+    def chunk(tag, body):
+        return (struct.pack('>I', len(body)) + tag + body +
+                struct.pack('>I', zlib.crc32(tag + body) & 0xFFFFFFFF))
+    raw = b''
+    for row in rows:
+        packed = bytearray((width + 7) // 8)
+        for x, ink in enumerate(row):
+            # 1-bit grayscale, ink is black on white
+            if not ink:
+                packed[x // 8] |= 0x80 >> (x % 8)
+        raw += b'\0' + bytes(packed)
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 1, 0, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        f.write(chunk(b'IEND', b''))
+
+
+def main():
+    with open(FONT, 'rb') as f:
+        font = tables(f.read())
+    units = struct.unpack('>H', font['head'][18:20])[0]
+    long_loca = struct.unpack('>h', font['head'][50:52])[0] == 1
+    ascender = struct.unpack('>h', font['hhea'][4:6])[0]
+    metrics = struct.unpack('>H', font['hhea'][34:36])[0]
+    scale = PIXEL_SIZE / float(units)
+
+    glyphs = []
+    for char in CHARACTERS:
+        index = glyph_index(font['cmap'], char)
+        at = 4 * min(index, metrics - 1)
+        advance = struct.unpack('>H', font['hmtx'][at:at + 2])[0]
+        polygons = [flatten(c) for c in glyph_contours(font['glyf'], font['loca'], long_loca, index)]
+        glyphs.append((char, int(round(advance * scale)), polygons))
+
+    # Cells run from the top of the tallest glyph down to the baseline
+    top = max(y for _, _, polygons in glyphs for polygon in polygons for _, y in polygon)
+    height = int(-(-top * scale // 1))
+    width = sum(advance for _, advance, _ in glyphs)
+
+    rows = [[False] * width for _ in range(height)]
+    left = 0
+    for char, advance, polygons in glyphs:
+        for row in range(height):
+            for column in range(advance):
+                hits = 0
+                for sy in range(SUPERSAMPLE):
+                    for sx in range(SUPERSAMPLE):
+                        x = (column + (sx + 0.5) / SUPERSAMPLE) / scale
+                        y = (height - row - (sy + 0.5) / SUPERSAMPLE) / scale
+                        hits += covered(polygons, x, y)
+                rows[row][left + column] = hits * 2 >= SUPERSAMPLE * SUPERSAMPLE
+        left += advance
+
+    png(OUTPUT, width, height, rows)
+    print('DIGIT_ATLAS_DIGIT_WIDTH %d' % glyphs[0][1])
+    print('DIGIT_ATLAS_COLON_WIDTH %d' % glyphs[-1][1])
+    print('DIGIT_ATLAS_HEIGHT %d' % height)
+    # Distance from the top of the text box to the top of the cells
+    print('DIGIT_ATLAS_TOP %d' % int(round((ascender - top) * scale)))
+
+
+if __name__ == '__main__':
+    main()